@@ -0,0 +1,7 @@
+#include "aabb.h"
+#include "entity.h"
+
+AABB bounding_box(const Entity& entity) {
+    Vec<double> half{entity.size.x / 2.0, entity.size.y / 2.0};
+    return AABB{entity.physics.position + half, half};
+}
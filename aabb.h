@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "vec.h"
+
+class Entity;
+
+// rectangular AABB
+template <typename Scalar>
+struct BasicAABB {
+    Vec<Scalar> center, half_dimension;
+
+    bool contains(const Vec<Scalar>& point) const;
+    bool intersects(const BasicAABB& other) const;
+
+    // from the closest point of the box, zero inside it
+    Scalar distance_squared(const Vec<Scalar>& point) const;
+};
+
+using AABB = BasicAABB<double>;
+
+// the area an entity covers, from physics.position (its bottom left corner)
+// up to its size
+AABB bounding_box(const Entity& entity);
+
+template <typename Scalar>
+bool BasicAABB<Scalar>::contains(const Vec<Scalar>& point) const {
+    Vec<Scalar> displacement = point - center;
+    return std::abs(displacement.x) < half_dimension.x
+        && std::abs(displacement.y) < half_dimension.y;
+}
+
+template <typename Scalar>
+bool BasicAABB<Scalar>::intersects(const BasicAABB& other) const {
+    Vec<Scalar> displacement = other.center - center;
+    return std::abs(displacement.x) < (other.half_dimension.x + half_dimension.x)
+        && std::abs(displacement.y) < (other.half_dimension.y + half_dimension.y);
+}
+
+template <typename Scalar>
+Scalar BasicAABB<Scalar>::distance_squared(const Vec<Scalar>& point) const {
+    Scalar dx = std::max(std::abs(point.x - center.x) - half_dimension.x, Scalar{0});
+    Scalar dy = std::max(std::abs(point.y - center.y) - half_dimension.y, Scalar{0});
+    return dx * dx + dy * dy;
+}
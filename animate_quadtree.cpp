@@ -7,7 +7,7 @@
 
 void draw_AABB(Graphics& graphics, AABB boundary, const Color& color={255, 255, 255, 255});
 void draw_point(Graphics& graphics, Vec<double> point, const Color& color={255, 0, 0, 255});
-void draw_quadtree(Graphics& graphics, const QuadTree& quadtree);
+void draw_quadtree(Graphics& graphics, const PointQuadTree& quadtree);
 
 
 int main() {
@@ -20,7 +20,7 @@ int main() {
     };
 
     AABB boundary{{1280.0/2, 720.0/2}, {580, 300}};
-    QuadTree quadtree{boundary};
+    PointQuadTree quadtree{boundary};
 
     double dt{0.2};
     double elapsed{0};
@@ -68,12 +68,8 @@ void draw_point(Graphics& graphics, Vec<double> point, const Color& color) {
     graphics.draw(rect, color, true);
 }
 
-void draw_quadtree(Graphics& graphics, const QuadTree& quadtree) {
-    draw_AABB(graphics, quadtree.boundary);
-    if (quadtree.nw) {
-        draw_quadtree(graphics, *quadtree.nw);
-        draw_quadtree(graphics, *quadtree.ne);
-        draw_quadtree(graphics, *quadtree.sw);
-        draw_quadtree(graphics, *quadtree.se);
+void draw_quadtree(Graphics& graphics, const PointQuadTree& quadtree) {
+    for (const PointQuadTree::Node& node : quadtree.nodes) {
+        draw_AABB(graphics, node.boundary);
     }
 }
@@ -50,6 +50,10 @@ int AnimatedSprite::number_of_frames() const {
     return sprites.size();
 }
 
+int AnimatedSprite::frame() const {
+    return current_frame;
+}
+
 void AnimatedSprite::rotate(int degrees) {
     for (auto& sprite : sprites) {
         sprite.angle = degrees;
@@ -12,6 +12,7 @@ public:
     void reset();                  // set current_frame and time to zero
     Sprite get_sprite() const;
     int number_of_frames() const;
+    int frame() const;             // index of the current frame
     void rotate(int degrees);
     bool loop = true;
         
@@ -5,6 +5,7 @@
 #include "vec.h"
 #include "player.h"
 #include "enemy.h"
+#include <algorithm>
 #include <iostream>
 
 constexpr double v_factor = 2.5;
@@ -66,18 +67,139 @@ void Camera::render(const Tilemap& tilemap, bool grid_on) const {
     int xmax = std::min(visible_max.x, tilemap.width - 1);
     int ymax = std::min(visible_max.y, tilemap.height - 1);
 
-    // draw tiles
-    for (int y = ymin; y <= ymax; ++y) {
-        for (int x = xmin; x <= xmax; ++x) {
-            // tilemap(x, y).sprite.update(dt);
-            const Tile& tile = tilemap(x, y);
-            Vec<double> position{static_cast<double>(x), static_cast<double>(y)};
-            render(position, tile.sprite.get_sprite());
-            if (grid_on) {
+    // draw tiles a baked block at a time
+    int cxmin = xmin / RENDER_CHUNK;
+    int cymin = ymin / RENDER_CHUNK;
+    int cxmax = xmax / RENDER_CHUNK;
+    int cymax = ymax / RENDER_CHUNK;
+    int pixels = (RENDER_CHUNK + 2 * BAKE_MARGIN) * tilesize;
+    for (int cy = cymin; cy <= cymax; ++cy) {
+        for (int cx = cxmin; cx <= cxmax; ++cx) {
+            Vec<int> chunk{cx, cy};
+            BakedChunk& baked_chunk = baked[chunk];
+            if (stale(tilemap, chunk, baked_chunk)) {
+                bake(tilemap, chunk, baked_chunk);
+            }
+
+            if (baked_chunk.texture_id >= 0) {
+                // tiles are drawn centered on their coordinates, so the
+                // block's corner is half a tile off its first tile, and the
+                // texture's corner is the margin beyond that
+                Vec<double> origin{static_cast<double>(cx * RENDER_CHUNK - BAKE_MARGIN), static_cast<double>(cy * RENDER_CHUNK - BAKE_MARGIN)};
+                Vec<int> pixel = world_to_screen(origin);
+                pixel += Vec{-tilesize / 2, tilesize / 2 - pixels};
+                graphics.draw_sprite(pixel, Sprite{baked_chunk.texture_id, {0, 0}, {pixels, pixels}});
+            }
+            else if (!baked_chunk.empty) {
+                int x0 = cx * RENDER_CHUNK;
+                int y0 = cy * RENDER_CHUNK;
+                render_tiles(tilemap, x0, y0, std::min(x0 + RENDER_CHUNK, tilemap.width) - 1,
+                             std::min(y0 + RENDER_CHUNK, tilemap.height) - 1);
+            }
+        }
+    }
+
+    if (grid_on) {
+        for (int y = ymin; y <= ymax; ++y) {
+            for (int x = xmin; x <= xmax; ++x) {
+                Vec<double> position{static_cast<double>(x), static_cast<double>(y)};
                 render(position, Color{0, 0, 0, 255}, false);
             }
         }
     }
+
+    // keep the textures of blocks well out of view for the next ones baked
+    for (auto it = baked.begin(); it != baked.end();) {
+        const Vec<int>& chunk = it->first;
+        if (chunk.x < cxmin - 1 || chunk.x > cxmax + 1 || chunk.y < cymin - 1 || chunk.y > cymax + 1) {
+            if (it->second.texture_id >= 0) {
+                spare_targets.push_back(it->second.texture_id);
+            }
+            it = baked.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool Camera::stale(const Tilemap& tilemap, const Vec<int>& chunk, const BakedChunk& baked_chunk) const {
+    if (baked_chunk.revision != tilemap.revision(chunk.x * RENDER_CHUNK, chunk.y * RENDER_CHUNK)) {
+        return true;
+    }
+    return std::any_of(baked_chunk.frames.begin(), baked_chunk.frames.end(), [](const auto& baked_frame) {
+        return baked_frame.first->frame() != baked_frame.second;
+    });
+}
+
+void Camera::bake(const Tilemap& tilemap, const Vec<int>& chunk, BakedChunk& baked_chunk) const {
+    int x0 = chunk.x * RENDER_CHUNK;
+    int y0 = chunk.y * RENDER_CHUNK;
+    int x1 = std::min(x0 + RENDER_CHUNK, tilemap.width) - 1;
+    int y1 = std::min(y0 + RENDER_CHUNK, tilemap.height) - 1;
+
+    baked_chunk.revision = tilemap.revision(x0, y0);
+    baked_chunk.frames.clear();
+    baked_chunk.empty = true;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const AnimatedSprite* sprite = tilemap(x, y).sprite.get();
+            if (!sprite) {
+                continue;
+            }
+            baked_chunk.empty = false;
+            auto baked_frame = std::find_if(baked_chunk.frames.begin(), baked_chunk.frames.end(),
+                                            [&](const auto& frame) {return frame.first == sprite;});
+            if (sprite->number_of_frames() > 1 && baked_frame == baked_chunk.frames.end()) {
+                baked_chunk.frames.push_back({sprite, sprite->frame()});
+            }
+        }
+    }
+
+    if (baked_chunk.empty) {
+        if (baked_chunk.texture_id >= 0) {
+            spare_targets.push_back(baked_chunk.texture_id);
+            baked_chunk.texture_id = -1;
+        }
+        return;
+    }
+    if (baked_chunk.texture_id < 0 && !spare_targets.empty()) {
+        baked_chunk.texture_id = spare_targets.back();
+        spare_targets.pop_back();
+    }
+    if (baked_chunk.texture_id < 0) {
+        int pixels = (RENDER_CHUNK + 2 * BAKE_MARGIN) * tilesize;
+        baked_chunk.texture_id = graphics.create_render_target(pixels, pixels);
+        if (baked_chunk.texture_id < 0) {
+            return;
+        }
+    }
+
+    // same placement as render(position, sprite), with y flipped inside the
+    // texture and tiles filling their cells
+    graphics.set_render_target(baked_chunk.texture_id);
+    graphics.clear(Color{0, 0, 0, 0});
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const Tile& tile = tilemap(x, y);
+            if (tile.sprite) {
+                Vec<int> pixel{(x - x0 + BAKE_MARGIN) * tilesize + tilesize / 2, (RENDER_CHUNK + BAKE_MARGIN - (y - y0)) * tilesize};
+                graphics.draw_sprite(pixel, tile.sprite->get_sprite());
+            }
+        }
+    }
+    graphics.set_render_target(-1);
+}
+
+void Camera::render_tiles(const Tilemap& tilemap, int x0, int y0, int x1, int y1) const {
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const Tile& tile = tilemap(x, y);
+            if (tile.sprite) {
+                render(Vec<double>{static_cast<double>(x), static_cast<double>(y)}, tile.sprite->get_sprite());
+            }
+        }
+    }
 }
 
 void Camera::render(const Vec<double>& position, const Sprite& sprite) const {
@@ -95,14 +217,26 @@ void Camera::render(const Entity& player) const {
 }
 
 void Camera::render(const std::vector<std::pair<Sprite, int>>& backgrounds) const {
+    // one layer each, so they stay in order from farthest to nearest
     for (auto [sprite, distance] : backgrounds) {
         int shift = static_cast<int>(location.x / (distance*0.5));
         graphics.draw_sprite({-shift, 0}, sprite);
+        ++graphics.layer;
     }
 }
 
 void Camera::update_tiles(Tilemap& tilemap, double dt) {
     tilemap.update(dt);
+    // keep a chunk of margin so chunks on the edge of view aren't reloaded
+    // every time the camera turns around
+    constexpr int margin = Tilemap::CHUNK_SIZE;
+    tilemap.evict_outside(visible_min.x - margin, visible_min.y - margin, visible_max.x + margin, visible_max.y + margin);
+}
+
+AABB Camera::visible_box(double margin) const {
+    Vec<double> min{visible_min.x - margin, visible_min.y - margin};
+    Vec<double> max{visible_max.x + 1 + margin, visible_max.y + 1 + margin};
+    return AABB{(min + max) / 2.0, (max - min) / 2.0};
 }
 
 void Camera::calculate_visible_tiles() {
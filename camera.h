@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "vec.h"
+#include "aabb.h"
 #include "entity.h"
 
 // forward declarations
@@ -10,6 +15,7 @@ class Tilemap;
 class Sprite;
 class Player;
 class Enemy;
+class AnimatedSprite;
 
 class Camera {
 public:
@@ -18,6 +24,9 @@ public:
     void move_to(const Vec<double>& new_location);
     void update(double dt);
     Vec<int> world_to_screen(const Vec<double>& world_position) const;
+    // the tiles in view, grown by margin tiles on every side, in world
+    // coordinates for spatial queries
+    AABB visible_box(double margin = 0) const;
 
     void render(const Vec<double>& position, const Color& color, bool filled = true) const;
     void render(const Tilemap& tilemap, bool grid_on = false) const;
@@ -36,4 +45,23 @@ private:
     Vec<double> velocity = 0;
     void calculate_visible_tiles();
     Vec<int> visible_min, visible_max;
+
+    // the tilemap is drawn from textures baked for RENDER_CHUNK square
+    // blocks of tiles, rebaked when the tilemap's revision for the block or
+    // a frame of one of its animations changes
+    static constexpr int RENDER_CHUNK = 8;
+    // baked textures reach this many tiles past their block on every side,
+    // so sprites overhanging their cells at the block's edge aren't cut off
+    static constexpr int BAKE_MARGIN = 1;
+    struct BakedChunk {
+        int texture_id{-1}; // -1 if empty, or drawn tile by tile without render targets
+        bool empty{false};
+        std::uint64_t revision{0};
+        std::vector<std::pair<const AnimatedSprite*, int>> frames; // animation and frame baked
+    };
+    mutable std::unordered_map<Vec<int>, BakedChunk> baked;
+    mutable std::vector<int> spare_targets; // textures of blocks out of view
+    bool stale(const Tilemap& tilemap, const Vec<int>& chunk, const BakedChunk& baked_chunk) const;
+    void bake(const Tilemap& tilemap, const Vec<int>& chunk, BakedChunk& baked_chunk) const;
+    void render_tiles(const Tilemap& tilemap, int x0, int y0, int x1, int y1) const;
 };
\ No newline at end of file
@@ -4,7 +4,8 @@
 #include <iostream>
 
 Enemy::Enemy(const Vec<double>& position, const Vec<int>& size, EnemyType& type)
-    :last_edge_position{position}, size{size}, type{type} {
+    :last_edge_position{position}, type{type} {
+        this->size = size;
         physics.position = position;
         physics.acceleration = type.acceleration;
         physics.acceleration.y = gravity;
@@ -22,26 +23,18 @@ std::unique_ptr<Command> Enemy::update(Engine& engine, double dt) {
         physics.velocity.x *= 0.92;
         physics.acceleration.y = gravity;
 
-        // Check for collisions
-        // attempt to move in x
-        Vec<double> future{physics.position.x, old.position.y};
-        Vec<double> vx{physics.velocity.x, 0};
-        engine.world->move_to(future, size, vx);
-
-        // attempt to move in y
-        Vec<double> vy{0, physics.velocity.y};
-        future.y = physics.position.y;
-        engine.world->move_to(future, size, vy);
+        // move from where we were, stopping at walls
+        Vec<double> position = old.position;
+        engine.world->move_by(position, size, physics.velocity, physics.position - old.position);
+        physics.position = position;
 
-        // update position and velocity
-        if (vx.x > type.x_velocity_max && (physics.acceleration.x > 0)) {
-            vx.x = type.x_velocity_max;
+        // update velocity
+        if (physics.velocity.x > type.x_velocity_max && (physics.acceleration.x > 0)) {
+            physics.velocity.x = type.x_velocity_max;
         }
-        else if (vx.x < -type.x_velocity_max && (physics.acceleration.x < 0)) {
-            vx.x = -type.x_velocity_max;
+        else if (physics.velocity.x < -type.x_velocity_max && (physics.acceleration.x < 0)) {
+            physics.velocity.x = -type.x_velocity_max;
         }
-        physics.position = future;
-        physics.velocity = {vx.x, vy.y};
 
         if (combat.invincible) {
             type.elapsed_time += dt;
@@ -49,7 +42,7 @@ std::unique_ptr<Command> Enemy::update(Engine& engine, double dt) {
         }
 
         // check for collision with wall
-        if (vx.x == 0 && physics.acceleration.x != 0) {
+        if (physics.velocity.x == 0 && physics.acceleration.x != 0) {
             type.animation.flip(-physics.acceleration.x < 0);
             last_edge_position = physics.position;
             return std::make_unique<Accelerate>(-physics.acceleration.x);
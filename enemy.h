@@ -14,7 +14,7 @@ public:
     std::unique_ptr<Command> next_action(Engine& engine);
 
     Vec<double> last_edge_position;
-    Vec<int> size;
+    Vec<double> indexed_position; // where World's spatial index last stored this enemy
     EnemyType type;
     bool temp{true};
 };
\ No newline at end of file
@@ -9,7 +9,7 @@
 
 Engine::Engine(const Settings& settings)
     : graphics{settings.title, settings.screen_width, settings.screen_height},
-      camera{graphics, settings.tilesize} {
+      camera{graphics, settings.tilesize}, broadphase{settings.broadphase} {
     
     load_level(settings.starting_level);
 }
@@ -17,7 +17,7 @@ Engine::Engine(const Settings& settings)
 void Engine::load_level(const std::string& level_filename) {
     Level level{level_filename, graphics, audio};
     // audio.play_sound("background", true);
-    world = std::make_shared<World>(level);
+    world = std::make_shared<World>(level, broadphase);
 
     // load player
     player = std::make_shared<Player>(*this, level.player_start_pos, Vec<int>{1, 1});
@@ -79,11 +79,12 @@ void Engine::update(double dt) {
     }
 
     // handle collisions between player and enemy
-    world->build_quadtree();
-    AABB player_box{player->physics.position, {1.0 * player->size.x, 1.0 * player->size.y}};
-    std::vector<Entity*> enemies = world->quadtree.query_range(player_box);
-    if (enemies.size() > 0) {
-        auto enemy = enemies.front();
+    world->update_spatial_index();
+    AABB player_box = bounding_box(*player);
+    nearby.clear();
+    world->query_range(player_box, nearby);
+    if (nearby.size() > 0) {
+        auto enemy = nearby.front();
         if (enemy->combat.is_alive && !player->grounded && player->combat.is_alive) {
             enemy->combat.attack(*player);
             // enter hurting state
@@ -98,29 +99,31 @@ void Engine::update(double dt) {
         
     }
 
-    for (auto & projectile : world->projectiles) {
-        AABB p_box{projectile.physics.position, {1.0*projectile.size.x, 1.0*projectile.size.y}};
-        std::vector<Entity*> entities = world->quadtree.query_range(p_box);
-        entities.erase(std::remove_if(entities.begin(), entities.end(), [](Entity* entity){return !entity->combat.is_alive;}), entities.end());
-        for (auto entity : entities) {
-            if (entity->combat.is_alive) {
-                projectile.combat.attack(*entity);
-            }
-            
-            if (entity->physics.velocity.y == 0) {
-                entity->physics.velocity.y = 2;
-            }
-            if (projectile.sprite.flip == false) {
-                entity->physics.velocity.x = 2;
-            }
-            else {
-                entity->physics.velocity.x = -2;
-            }
+    // handle collisions between projectiles and enemies, all pairs at once
+    projectile_boxes.clear();
+    for (auto& projectile : world->projectiles) {
+        projectile_boxes.push_back(bounding_box(projectile));
+    }
+    hits.clear();
+    world->sweep.overlaps(projectile_boxes, hits);
+    for (auto [index, entity] : hits) {
+        // an earlier hit this tick may have finished the enemy off
+        if (!entity->combat.is_alive) {
+            continue;
         }
-        
-        if (entities.size() > 0) {
-            projectile.hit_enemy = true;
+        Projectile& projectile = world->projectiles[index];
+        projectile.combat.attack(*entity);
+
+        if (entity->physics.velocity.y == 0) {
+            entity->physics.velocity.y = 2;
+        }
+        if (projectile.sprite.flip == false) {
+            entity->physics.velocity.x = 2;
+        }
+        else {
+            entity->physics.velocity.x = -2;
         }
+        projectile.hit_enemy = true;
     }
 
     // check for deaths
@@ -129,20 +132,39 @@ void Engine::update(double dt) {
 
 void Engine::render(double dt) {
     graphics.clear();
+    // each pass is drawn on a layer above the last, so batching sprites by
+    // texture keeps the passes in this order
+    graphics.layer = 0;
     camera.render(world->backgrounds);
+    ++graphics.layer;
     camera.render(world->tilemap, grid_on);
-    
-    for (auto enemy : world->enemies) {
+    ++graphics.layer;
+
+    // only what is near the screen is drawn, with room for sprites and
+    // health bars that reach past an entity's body
+    AABB view = camera.visible_box(4);
+    nearby.clear();
+    world->query_range(view, nearby);
+    for (Entity* enemy : nearby) {
         camera.render(*enemy);
+    }
+    // health bars aren't batched and drawing one flushes the batch, so they
+    // go after all the enemies
+    for (Entity* enemy : nearby) {
         if (enemy->combat.is_alive) {
-            camera.render_enemy_health(*enemy);
+            // the spatial index only holds enemies
+            camera.render_enemy_health(static_cast<const Enemy&>(*enemy));
         }
     }
+    ++graphics.layer;
     auto [position, color] = player->get_sprite();
     camera.render(position, player->sprite);
     camera.render(*player);
+    ++graphics.layer;
     for (auto& projectile : world->projectiles) {
-        camera.render(projectile);
+        if (view.intersects(bounding_box(projectile))) {
+            camera.render(projectile);
+        }
     }
     camera.render_life(player->combat.health, player->combat.max_health);
     graphics.update();
@@ -198,7 +220,11 @@ void Engine::run() {
                     break;
                 }
             }
+            // the words on a layer above the background, as sprites in one
+            // layer are drawn a texture at a time
+            graphics.layer = 0;
             camera.render_screen({640, 720}, bkg);
+            ++graphics.layer;
             if (win) {
                 camera.render_screen({640, 840}, words1);
             }
@@ -28,11 +28,14 @@ public:
     std::optional<std::string> next_level;
     bool win{false};
 private:
+    std::string broadphase; // how World indexes enemies, see settings.txt
     bool running{true};
     bool window_open{true};
     bool grid_on{false};
     bool game_over{false};
-    
+    std::vector<Entity*> nearby; // reused buffers for spatial queries
+    std::vector<AABB> projectile_boxes;
+    std::vector<SweepAndPrune::Overlap> hits;
 
     void input();
     void update(double dt);
@@ -9,6 +9,7 @@ public:
     Physics physics;
     Sprite sprite;
     Combat combat;
+    Vec<int> size{1, 1}; // extends up and to the right of physics.position
     int gun_level{0};
     bool carrying{false};
 };
\ No newline at end of file
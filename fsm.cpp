@@ -1,15 +1,20 @@
 #include "fsm.h"
 #include "player.h"
 #include "engine.h"
+#include <cmath>
 #include <iostream>
 #include <randomness.h>
 
 
 bool on_platform(const Player& player, const World& world) {
+    // the row of tiles just under the box, which like sweep_box covers
+    // [x, x + size.x), so a box whose edge meets a ledge has walked off it
     constexpr double epsilon = 1e-2;
-    Vec<double> left_foot{player.physics.position.x, player.physics.position.y - epsilon};
-    Vec<double> right_foot{player.physics.position.x+player.size.x, player.physics.position.y - epsilon};
-    return world.collides(left_foot) || world.collides(right_foot);
+    const Vec<double>& position = player.physics.position;
+    int y = std::floor(position.y - epsilon);
+    int x0 = std::floor(position.x);
+    int x1 = std::ceil(position.x + player.size.x) - 1;
+    return world.tilemap.any_blocking(x0, y, x1, y);
 }
 
 bool arrow_left = false;
@@ -28,24 +33,15 @@ std::unique_ptr<State> State::update(Player& player, Engine& engine, double dt)
     player.elapsed += dt;
     player.carrying_elapsed += dt;
     
-    // attempt to move in x first
-    Vec<double> future{player.physics.position.x, old.position.y};
-    Vec<double> vx{player.physics.velocity.x, 0};
-    engine.world->move_to(future, player.size, vx);
-
-    // attempt to move in y
-    Vec<double> vy{0, player.physics.velocity.y};
-    future.y = player.physics.position.y;
-    engine.world->move_to(future, player.size, vy);
-
-    // update player pos
-    player.physics.position = future;
-    player.physics.velocity = {vx.x, vy.y};
+    // move from where the player was, stopping at walls
+    Vec<double> position = old.position;
+    engine.world->move_by(position, player.size, player.physics.velocity, player.physics.position - old.position);
+    player.physics.position = position;
 
     
     
     // observe if current tile has command
-    auto command = engine.world->touch_tiles(player);
+    auto command = engine.world->touch_triggers(player);
     if (command) {
         command->execute(player, engine);
     }    
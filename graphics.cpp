@@ -3,6 +3,10 @@
 #include "randomness.h"
 #include <SDL2/SDL.h>
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <vector>
 #include <SDL_image.h>
 #include <iostream>
 #include <fstream>
@@ -21,12 +25,22 @@ Graphics::Graphics(const std::string& title, int window_width, int window_height
         std::cout << SDL_GetError() << '\n';
     }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
     if (!renderer) {
         std::cout << SDL_GetError() << '\n';
     }
     // make sure to check all return values and throw exceptions when errors occur
 
+    // atlas pages as large as the renderer allows, 0 meaning no limit
+    SDL_RendererInfo info;
+    if (renderer && SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (int max : {info.max_texture_width, info.max_texture_height}) {
+            if (max > 0) {
+                atlas_size = std::min(atlas_size, max);
+            }
+        }
+    }
+
     int img_flags = IMG_INIT_PNG;
     if (!(IMG_Init(img_flags) & img_flags)) {
         throw std::runtime_error(IMG_GetError());
@@ -51,7 +65,8 @@ void Graphics::load_spritesheet(const std::string& filename) {
     std::string parent_path{filename.substr(0, i+1)};
     image_filename = parent_path + image_filename; // assets/spritesheet.png
 
-    int texture_id = get_texture_id(image_filename);
+    // only read if some frame isn't in the atlas yet
+    SDL_Surface* image = nullptr;
 
     // load sprites -> unordered map <strings, sprites>
     std::string name;
@@ -66,13 +81,14 @@ void Graphics::load_spritesheet(const std::string& filename) {
             input.clear();
         }
         for (int i = 0; i < number_of_frames; ++i) {
-            Vec location{x + i * width, y};
-            Vec size{width, height};
-            Sprite sprite{texture_id, location, size, scale, shift, center};
+            Sprite sprite = pack(image_filename, {x + i * width, y, width, height}, image);
+            sprite.scale = scale;
+            sprite.shift = shift;
+            sprite.center = center;
             sprites[name].push_back(sprite);
         }
     }
-
+    SDL_FreeSurface(image);
 }
 
 Sprite Graphics::get_sprite(const std::string& name) const {
@@ -117,32 +133,134 @@ void Graphics::draw_sprite(const Vec<int>& pixel, const Sprite& sprite) {
     // Calculate the center of the scaled up sprite
     SDL_Point center{sprite.center.x * sprite.scale, sprite.center.y * sprite.scale};
     SDL_Rect image_pixels{sprite.location.x, sprite.location.y, sprite.size.x, sprite.size.y};
-    
-    // Get the sprite's SDL texture
-    SDL_Texture* texture = textures.at(sprite.texture_id);
-    SDL_RendererFlip flip = sprite.flip ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
 
-    // Draw the sprite on screen taking into account rotation (sprite.angle) about its center,
-    // and whether to flip the sprite horizontally
-    SDL_RenderCopyEx(renderer, texture, &image_pixels, &screen_pixels, sprite.angle, &center, flip);
+    // drawn with the rest of its texture when the batch is flushed
+    batch.push_back({layer, sprite.texture_id, screen_pixels, image_pixels, center, sprite.angle, sprite.flip});
+}
+
+void Graphics::flush() {
+    // stable, so sprites of a texture keep the order they were drawn in
+    std::stable_sort(batch.begin(), batch.end(), [](const BatchedSprite& a, const BatchedSprite& b) {
+        return std::tie(a.layer, a.texture_id) < std::tie(b.layer, b.texture_id);
+    });
+    for (std::size_t begin = 0; begin < batch.size();) {
+        std::size_t end = begin + 1;
+        while (end < batch.size() && batch[end].texture_id == batch[begin].texture_id) {
+            ++end;
+        }
+        draw_batch(begin, end);
+        begin = end;
+    }
+    batch.clear();
+}
+
+void Graphics::draw_batch(std::size_t begin, std::size_t end) {
+    SDL_Texture* texture = textures.at(batch[begin].texture_id);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (geometry_supported) {
+        // one quad per sprite, flipped and rotated here the way
+        // SDL_RenderCopyEx would: mirrored horizontally in the texture, then
+        // turned clockwise about center
+        const Vec<int>& size = texture_sizes.at(batch[begin].texture_id);
+        vertices.clear();
+        indices.clear();
+        for (std::size_t i = begin; i < end; ++i) {
+            const BatchedSprite& s = batch[i];
+            double radians = s.angle * M_PI / 180.0;
+            double cos = std::cos(radians);
+            double sin = std::sin(radians);
+            double pivot_x = s.screen_pixels.x + s.center.x;
+            double pivot_y = s.screen_pixels.y + s.center.y;
+            auto corner = [&](int dx, int dy) {
+                double x = dx - s.center.x;
+                double y = dy - s.center.y;
+                return SDL_FPoint{static_cast<float>(pivot_x + x * cos - y * sin),
+                                  static_cast<float>(pivot_y + x * sin + y * cos)};
+            };
+
+            float u0 = static_cast<float>(s.image_pixels.x) / size.x;
+            float u1 = static_cast<float>(s.image_pixels.x + s.image_pixels.w) / size.x;
+            float v0 = static_cast<float>(s.image_pixels.y) / size.y;
+            float v1 = static_cast<float>(s.image_pixels.y + s.image_pixels.h) / size.y;
+            if (s.flip) {
+                std::swap(u0, u1);
+            }
+
+            SDL_Color white{255, 255, 255, 255};
+            int first = vertices.size();
+            vertices.push_back({corner(0, 0), white, {u0, v0}});
+            vertices.push_back({corner(s.screen_pixels.w, 0), white, {u1, v0}});
+            vertices.push_back({corner(s.screen_pixels.w, s.screen_pixels.h), white, {u1, v1}});
+            vertices.push_back({corner(0, s.screen_pixels.h), white, {u0, v1}});
+            for (int index : {0, 1, 2, 0, 2, 3}) {
+                indices.push_back(first + index);
+            }
+        }
+        if (SDL_RenderGeometry(renderer, texture, vertices.data(), vertices.size(), indices.data(), indices.size()) == 0) {
+            return;
+        }
+        // the renderer can't draw geometry, copy sprites one at a time from now on
+        geometry_supported = false;
+    }
+#endif
+    for (std::size_t i = begin; i < end; ++i) {
+        const BatchedSprite& s = batch[i];
+        SDL_RendererFlip flip = s.flip ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
+        SDL_RenderCopyEx(renderer, texture, &s.image_pixels, &s.screen_pixels, s.angle, &s.center, flip);
+    }
 }
 
 Sprite Graphics::load_image(const std::string& filename) {
-    int id = get_texture_id(filename);
-    SDL_Texture* texture = textures.at(id);
-    int width, height;
-    SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
-    Sprite sprite{id, {0, 0}, {width, height}};
+    SDL_Surface* image = nullptr;
+    Sprite sprite = pack(filename, {0, 0, -1, -1}, image);
+    SDL_FreeSurface(image);
     return sprite;
 }
 
+int Graphics::create_render_target(int width, int height) {
+    if (!SDL_RenderTargetSupported(renderer)) {
+        return -1;
+    }
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!texture) {
+        return -1;
+    }
+    // sprites blended into a target cleared to transparent leave its color
+    // already multiplied by alpha, so it is drawn without applying alpha to
+    // the color again
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if (SDL_SetTextureBlendMode(texture, premultiplied) < 0) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+
+    return add_texture(texture);
+}
+
+void Graphics::set_render_target(int texture_id) {
+    flush();
+    SDL_Texture* texture = texture_id < 0 ? nullptr : textures.at(texture_id);
+    if (SDL_SetRenderTarget(renderer, texture) < 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+}
+
 void Graphics::clear() {
+    flush();
     // clear the screen by painting it black
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
 }
 
+void Graphics::clear(const Color& color) {
+    flush();
+    SDL_SetRenderDrawColor(renderer, color.red, color.green, color.blue, color.alpha);
+    SDL_RenderClear(renderer);
+}
+
 void Graphics::draw(const SDL_Rect& rect, const Color& color, bool filled) {
+    flush();
     SDL_SetRenderDrawColor(renderer, color.red, color.green, color.blue, color.alpha);
     if (filled) {
         SDL_RenderFillRect(renderer, &rect);
@@ -154,6 +272,7 @@ void Graphics::draw(const SDL_Rect& rect, const Color& color, bool filled) {
 
 void Graphics::update() {
     // show the current canvas on the screen
+    flush();
     SDL_RenderPresent(renderer);
 }
 
@@ -169,11 +288,105 @@ int Graphics::get_texture_id(const std::string& image_filename) {
             throw std::runtime_error(IMG_GetError());
         }
         // register new texture
-        int texture_id = textures.size();
+        int texture_id = add_texture(texture);
         texture_ids[image_filename] = texture_id;
-
-        // retain ownership of texture pointers
-        textures.push_back(texture);
         return texture_id;
     }
 }
+
+int Graphics::add_texture(SDL_Texture* texture) {
+    // retain ownership of texture pointers
+    int texture_id = textures.size();
+    textures.push_back(texture);
+
+    Vec<int> size;
+    SDL_QueryTexture(texture, nullptr, nullptr, &size.x, &size.y);
+    texture_sizes.push_back(size);
+    return texture_id;
+}
+
+Sprite Graphics::pack(const std::string& image_filename, const SDL_Rect& frame, SDL_Surface*& image) {
+    // every level loads its theme's files again, so frames are packed once
+    std::string key = image_filename + ' ' + std::to_string(frame.x) + ' ' + std::to_string(frame.y) + ' '
+                    + std::to_string(frame.w) + ' ' + std::to_string(frame.h);
+    auto found = packed.find(key);
+    if (found != packed.end()) {
+        return found->second;
+    }
+
+    if (!image) {
+        SDL_Surface* loaded = IMG_Load(image_filename.c_str());
+        if (!loaded) {
+            throw std::runtime_error(IMG_GetError());
+        }
+        // a byte per channel in a known order, to copy straight into a page
+        image = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(loaded);
+        if (!image) {
+            throw std::runtime_error(SDL_GetError());
+        }
+    }
+    SDL_Rect source = frame;
+    if (source.w < 0) { // the whole image
+        source.w = image->w;
+        source.h = image->h;
+    }
+
+    Sprite sprite;
+    sprite.size = {source.w, source.h};
+    bool inside = source.x >= 0 && source.y >= 0 && source.w > 0 && source.h > 0
+                  && source.x + source.w <= image->w && source.y + source.h <= image->h;
+    // a pixel of space after each frame, so filtering doesn't bleed its
+    // neighbours in
+    if (!inside || !allocate(source.w + 1, source.h + 1, sprite.texture_id, sprite.location)) {
+        sprite.texture_id = get_texture_id(image_filename);
+        sprite.location = {source.x, source.y};
+        return packed[key] = sprite;
+    }
+
+    SDL_Texture* page = textures.at(sprite.texture_id);
+    SDL_LockSurface(image);
+    const Uint8* pixels = static_cast<const Uint8*>(image->pixels) + source.y * image->pitch + source.x * 4;
+    SDL_Rect destination{sprite.location.x, sprite.location.y, source.w, source.h};
+    int result = SDL_UpdateTexture(page, &destination, pixels, image->pitch);
+    SDL_UnlockSurface(image);
+    if (result < 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    return packed[key] = sprite;
+}
+
+bool Graphics::allocate(int width, int height, int& texture_id, Vec<int>& location) {
+    if (width > atlas_size || height > atlas_size) {
+        return false;
+    }
+    for (AtlasPage& page : atlas_pages) {
+        // on the current shelf, or a new one below it
+        bool new_shelf = page.shelf_x + width > atlas_size;
+        int x = new_shelf ? 0 : page.shelf_x;
+        int y = new_shelf ? page.shelf_y + page.shelf_height : page.shelf_y;
+        if (y + height > atlas_size) {
+            continue;
+        }
+        if (new_shelf) {
+            page.shelf_y = y;
+            page.shelf_height = 0;
+        }
+        page.shelf_x = x + width;
+        page.shelf_height = std::max(page.shelf_height, height);
+        texture_id = page.texture_id;
+        location = {x, y};
+        return true;
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas_size, atlas_size);
+    if (!texture) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    // static textures start out undefined, not transparent
+    std::vector<Uint32> transparent(static_cast<std::size_t>(atlas_size) * atlas_size);
+    SDL_UpdateTexture(texture, nullptr, transparent.data(), atlas_size * 4);
+    atlas_pages.push_back({add_texture(texture)});
+    return allocate(width, height, texture_id, location);
+}
@@ -20,10 +20,20 @@ public:
     void load_spritesheet(const std::string& filename);
     Sprite get_sprite(const std::string& name) const;
     AnimatedSprite get_animated_sprite(const std::string& name, double dt_per_frame, bool random_start = false, bool shuffle_order = false) const;
+    // sprites are batched until the next draw, clear, render target change
+    // or update, then drawn layer by layer, and within a layer a texture at
+    // a time: sprites in one layer shouldn't rely on overlapping in order
     void draw_sprite(const Vec<int>& pixel, const Sprite& sprite);
+    int layer{0};
     Sprite load_image(const std::string& filename);
 
+    // a texture to draw into after set_render_target, then drawn like any
+    // other sprite. -1 if the renderer can't draw into textures
+    int create_render_target(int width, int height);
+    void set_render_target(int texture_id); // -1 for the window
+
     void clear();
+    void clear(const Color& color);
     void draw(const SDL_Rect& rect, const Color& color, bool filled=true);
     void update();
     const int width, height;
@@ -35,8 +45,41 @@ private:
     SDL_Renderer* renderer;
 
     std::vector<SDL_Texture*> textures;
+    std::vector<Vec<int>> texture_sizes;
     std::unordered_map<std::string, int> texture_ids;
     std::unordered_map<std::string, std::vector<Sprite>> sprites;
 
     int get_texture_id(const std::string& image_filename);
+    int add_texture(SDL_Texture* texture);
+
+    // Frames and images are packed into large atlas textures as they are
+    // loaded, in shelves filled left to right, so a level draws from a few
+    // textures instead of one per file. Anything too big for a page keeps
+    // a texture of its own
+    struct AtlasPage {
+        int texture_id;
+        int shelf_y{0}, shelf_height{0}, shelf_x{0}; // shelf being filled
+    };
+    std::vector<AtlasPage> atlas_pages;
+    int atlas_size{2048};
+    std::unordered_map<std::string, Sprite> packed; // by file and frame
+    Sprite pack(const std::string& image_filename, const SDL_Rect& frame, SDL_Surface*& image);
+    bool allocate(int width, int height, int& texture_id, Vec<int>& location);
+
+    struct BatchedSprite {
+        int layer, texture_id;
+        SDL_Rect screen_pixels, image_pixels;
+        SDL_Point center;
+        double angle;
+        bool flip;
+    };
+    std::vector<BatchedSprite> batch;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // older SDL has no geometry, and copies sprites one at a time
+    std::vector<SDL_Vertex> vertices; // reused between flushes
+    std::vector<int> indices;
+    bool geometry_supported{true};
+#endif
+    void flush();
+    void draw_batch(std::size_t begin, std::size_t end);
 };
@@ -2,6 +2,7 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include <array>
 #include <vector>
 #include "graphics.h"
 #include "audio.h"
@@ -56,15 +57,13 @@ void Level::load(Graphics& graphics, Audio& audio) {
                 continue;
             }
 
-            // determine tiletype
-            auto it = tile_types.find(symbol);
-            auto eit = enemy_types.find(symbol);
-            if (it != tile_types.end()) { // found
-                Vec<int> position{x, height - y - 1};
-                const Tile& tile = it->second;
-                tiles.push_back({position, tile});
+            // tiles are read from the layout by the tilemap as it needs them
+            if (tile_types.count(symbol)) {
+                continue;
             }
-            else if (eit != enemy_types.end()) {
+
+            auto eit = enemy_types.find(symbol);
+            if (eit != enemy_types.end()) {
                 Vec<double> position{static_cast<double>(x), static_cast<double>(height - 1 - y)};
                 const EnemyType& type = eit->second(graphics);
                 enemies.push_back({position, type});
@@ -74,6 +73,30 @@ void Level::load(Graphics& graphics, Audio& audio) {
             }
         }
     }
+    layout = std::make_shared<const std::vector<std::string>>(std::move(lines));
+}
+
+std::vector<Tile> Level::tile_table() const {
+    std::vector<Tile> table;
+    for (char symbol : tile_symbols) {
+        table.push_back(tile_types.at(symbol));
+    }
+    return table;
+}
+
+Tilemap::Source Level::tile_source() const {
+    // type 0 is air, the table's types follow
+    std::array<Tilemap::Type, 256> types{};
+    for (std::size_t i = 0; i < tile_symbols.size(); ++i) {
+        types[static_cast<unsigned char>(tile_symbols[i])] = i + 1;
+    }
+
+    // shared so neither the source nor its copies copy the level
+    auto rows = layout;
+    return [rows, types](int x, int y) {
+        const std::string& row = (*rows)[rows->size() - 1 - y];
+        return types[static_cast<unsigned char>(row[x])];
+    };
 }
 
 void Level::load_theme(const std::string& filename, Graphics& graphics, Audio& audio) {
@@ -143,7 +166,7 @@ void Level::load_theme(const std::string& filename, Graphics& graphics, Audio& a
                 throw std::runtime_error(msg);
             }
             AnimatedSprite sprite = graphics.get_animated_sprite(sprite_name, 0.1);
-            Tile tile{sprite, blocking};
+            Tile tile{std::make_shared<AnimatedSprite>(sprite), blocking};
             
 
             // read possible commands
@@ -155,6 +178,9 @@ void Level::load_theme(const std::string& filename, Graphics& graphics, Audio& a
                 }
                 tile.command = create_command(command_name, arguments);
             }
+            if (!tile_types.count(symbol)) {
+                tile_symbols.push_back(symbol);
+            }
             tile_types[symbol] = tile;
         } else {
             std::string msg = error_message(filename, line_num, "Unknown command", line);
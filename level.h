@@ -1,7 +1,9 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "vec.h"
 #include "sprite.h"
 #include "tilemap.h"
@@ -19,7 +21,15 @@ public:
     Vec<double> player_start_pos{-1, -1};
 
     std::unordered_map<char, Tile> tile_types;
-    std::vector<std::pair<Vec<int>, Tile>> tiles;
+    // the level file's rows, top first, one character per tile. Shared
+    // with the tilemap's source rather than copied into it
+    std::shared_ptr<const std::vector<std::string>> layout;
+
+    // the tile types in the order they were defined, and the layout read as
+    // indices into them for a Tilemap
+    std::vector<char> tile_symbols;
+    std::vector<Tile> tile_table() const;
+    Tilemap::Source tile_source() const;
     std::unordered_map<char, std::function<EnemyType(Graphics&)>> enemy_types;
     std::vector<std::pair<Vec<double>, EnemyType>> enemies;
     std::vector<std::pair<Sprite, int>> backgrounds;
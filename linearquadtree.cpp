@@ -0,0 +1,84 @@
+#include "linearquadtree.h"
+#include <cmath>
+
+LinearQuadTree::LinearQuadTree(AABB boundary)
+    :boundary{boundary} {
+    double cells = 1 << BITS;
+    scale = {cells / (2 * boundary.half_dimension.x), cells / (2 * boundary.half_dimension.y)};
+}
+
+void LinearQuadTree::clear() {
+    items.clear();
+}
+
+bool LinearQuadTree::insert(Entity* object) {
+    // ignore objects that don't belong
+    const Vec<double>& position = object->physics.position;
+    if (!boundary.contains(position)) {
+        return false;
+    }
+    items.push_back(Item{morton_code(position), position, object});
+    return true;
+}
+
+void LinearQuadTree::build() {
+    if (items.empty()) {
+        return;
+    }
+
+    // least significant digit radix sort, a byte per pass
+    scratch.resize(items.size());
+    std::size_t counts[4][256] = {};
+    for (const Item& item : items) {
+        for (int pass = 0; pass < 4; ++pass) {
+            ++counts[pass][(item.code >> (8 * pass)) & 0xff];
+        }
+    }
+
+    for (int pass = 0; pass < 4; ++pass) {
+        // every code has the same byte here, the order wouldn't change
+        if (counts[pass][(items[0].code >> (8 * pass)) & 0xff] == items.size()) {
+            continue;
+        }
+
+        std::size_t offsets[256];
+        std::size_t total = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            offsets[digit] = total;
+            total += counts[pass][digit];
+        }
+        for (const Item& item : items) {
+            scratch[offsets[(item.code >> (8 * pass)) & 0xff]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+std::vector<Entity*> LinearQuadTree::query_range(AABB range) const {
+    std::vector<Entity*> results;
+    query_range(range, results);
+    return results;
+}
+
+void LinearQuadTree::query_range(const AABB& range, std::vector<Entity*>& results) const {
+    query_range(range, [&](Entity* object) {
+        results.push_back(object);
+    });
+}
+
+// spread the low 16 bits out to the even bits
+static std::uint32_t interleave(std::uint32_t v) {
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+std::uint32_t LinearQuadTree::morton_code(const Vec<double>& position) const {
+    Vec<double> min = boundary.center - boundary.half_dimension;
+    double max_cell = (1 << BITS) - 1;
+    double x = std::clamp(std::floor((position.x - min.x) * scale.x), 0.0, max_cell);
+    double y = std::clamp(std::floor((position.y - min.y) * scale.y), 0.0, max_cell);
+    return interleave(static_cast<std::uint32_t>(x)) | (interleave(static_cast<std::uint32_t>(y)) << 1);
+}
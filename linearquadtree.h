@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "vec.h"
+#include "aabb.h"
+#include "entity.h"
+
+// A quadtree with no nodes: objects are sorted by the Morton (Z-order) code
+// of their physics.position, so every quadrant of every level is a
+// contiguous run of the array. Meant to be rebuilt every tick: insert
+// everything, then build() once before querying. Queries return the same
+// objects as a point QuadTree over the same boundary.
+class LinearQuadTree {
+public:
+    LinearQuadTree(AABB boundary);
+
+    void clear();
+    bool insert(Entity* object);
+    void build();
+
+    std::vector<Entity*> query_range(AABB range) const;
+    template <typename Visitor>
+    void query_range(const AABB& range, Visitor&& visit) const;
+    void query_range(const AABB& range, std::vector<Entity*>& results) const;
+    template <typename Predicate>
+    void query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const;
+
+    static constexpr int BITS = 16; // per axis, so the finest cell is 1/65536 of the boundary
+    static constexpr std::size_t LEAF_SIZE = 8; // runs this short are scanned, not split
+
+    struct Item {
+        std::uint32_t code;
+        Vec<double> position; // copied so queries don't touch the entities
+        Entity* object;
+    };
+
+    AABB boundary;
+    std::vector<Item> items; // sorted by code after build()
+
+private:
+    Vec<double> scale; // cells per unit length
+    std::vector<Item> scratch; // radix sort buffer, kept between builds
+
+    std::uint32_t morton_code(const Vec<double>& position) const;
+    template <typename Visitor>
+    void visit_range(std::size_t begin, std::size_t end, std::uint32_t code, int level,
+                     std::uint32_t x, std::uint32_t y, const AABB& range, Visitor& visit) const;
+};
+
+template <typename Visitor>
+void LinearQuadTree::query_range(const AABB& range, Visitor&& visit) const {
+    visit_range(0, items.size(), 0, 0, 0, 0, range, visit);
+}
+
+template <typename Predicate>
+void LinearQuadTree::query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const {
+    query_range(range, [&](Entity* object) {
+        if (predicate(object)) {
+            results.push_back(object);
+        }
+    });
+}
+
+template <typename Visitor>
+void LinearQuadTree::visit_range(std::size_t begin, std::size_t end, std::uint32_t code, int level,
+                                 std::uint32_t x, std::uint32_t y, const AABB& range, Visitor& visit) const {
+    if (begin == end) {
+        return;
+    }
+
+    // (x, y) is the cell's bottom left corner in cells of the finest level
+    int shift = BITS - level;
+    Vec<double> min = boundary.center - boundary.half_dimension;
+    Vec<double> size{(1u << shift) / scale.x, (1u << shift) / scale.y};
+    // grown by a cell so rounding in morton_code can't push a point outside
+    AABB cell{{min.x + x / scale.x + size.x / 2, min.y + y / scale.y + size.y / 2},
+              {size.x / 2 + 1 / scale.x, size.y / 2 + 1 / scale.y}};
+    if (!cell.intersects(range)) {
+        return;
+    }
+
+    // short runs and cells the range covers are scanned instead of split
+    Vec<double> displacement = cell.center - range.center;
+    bool covered = std::abs(displacement.x) + cell.half_dimension.x < range.half_dimension.x
+        && std::abs(displacement.y) + cell.half_dimension.y < range.half_dimension.y;
+    if (covered || end - begin <= LEAF_SIZE || level == BITS) {
+        for (std::size_t i = begin; i < end; ++i) {
+            if (range.intersects(AABB{items[i].position, {0, 0}})) {
+                visit(items[i].object);
+            }
+        }
+        return;
+    }
+
+    // split the run into the four quadrants by binary search on the code
+    std::uint32_t step = std::uint32_t{1} << (2 * (shift - 1));
+    std::uint32_t half = std::uint32_t{1} << (shift - 1);
+    std::size_t first = begin;
+    for (std::uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+        std::uint32_t child = code + quadrant * step;
+        std::size_t last = end;
+        if (quadrant < 3) {
+            auto it = std::lower_bound(items.begin() + first, items.begin() + end, child + step,
+                                       [](const Item& item, std::uint32_t c) {return item.code < c;});
+            last = it - items.begin();
+        }
+        visit_range(first, last, child, level + 1, x + (quadrant & 1) * half, y + (quadrant >> 1) * half,
+                    range, visit);
+        first = last;
+    }
+}
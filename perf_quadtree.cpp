@@ -1,8 +1,87 @@
 #include "quadtree.h"
+#include "linearquadtree.h"
+#include "spatialhashgrid.h"
+#include "entity.h"
 #include "randomness.h"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <new>
+#include <string>
+
+// Benchmarks the spatial indexes over a sweep of entity counts and layouts
+// and prints one CSV row per measurement:
+//   structure,distribution,n,operation,reps,ops,median_s,p95_s,allocations
+// Each repetition makes ops operations, one per object built or updated or
+// one per query, and is timed as a whole. allocations is the number of
+// heap allocations per operation. Pass a largest N to stop the sweep early,
+// e.g. `performance_qt 10000`.
+
+// every allocation in the program goes through here so each operation can
+// report how many it made
+static std::size_t allocations{0};
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// over-aligned types such as QuadTree's buckets come through these
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++allocations;
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
 class Timer {
 public:
     Timer() {
@@ -16,7 +95,7 @@ public:
         std::chrono::duration<double> elapsed = t1 - t0;
         return elapsed.count();
     }
-    
+
     std::chrono::time_point<std::chrono::high_resolution_clock> t0, t1;
 };
 
@@ -25,39 +104,241 @@ double random_double(double min, double max) {
     return dist(random_engine);
 }
 
-int main() {
-    int N = 10000;
-    double xmax = 10;
-    double ymax = 10;
-    std::vector<Vec<double>> points(N);
-    std::generate(std::begin(points), std::end(points),
-                  [=]() {
-                      double x = random_double(0, xmax);
-                      double y = random_double(0, ymax);
-                      return Vec<double>{x, y};
-                  });
-
-    
-    AABB boundary{{xmax/2, ymax/2}, {xmax/2, ymax/2}};
-    QuadTree quadtree{boundary};
+std::size_t random_index(std::size_t size) {
+    std::uniform_int_distribution<std::size_t> dist{0, size - 1};
+    return dist(random_engine);
+}
+
+// a level with a constant number of enemies per tile, four times as wide
+// as it is tall, filled with one of the layouts below
+struct Scene {
+    std::string distribution;
+    double width, height;
+    std::vector<Entity> entities;
+    std::vector<Vec<double>> velocities;
+    AABB boundary() const {
+        return AABB{{width / 2, height / 2}, {width / 2, height / 2}};
+    }
+};
+
+Scene make_scene(const std::string& distribution, int N) {
+    Scene scene{distribution, 4 * std::sqrt(N * 4.0), std::sqrt(N * 4.0), std::vector<Entity>(N), {}};
+    double width = scene.width - 1;
+    double height = scene.height - 1;
+    auto clamp = [&](Vec<double> p) {
+        return Vec<double>{std::clamp(p.x, 0.0, width), std::clamp(p.y, 0.0, height)};
+    };
+
+    if (distribution == "uniform") {
+        for (Entity& entity : scene.entities) {
+            entity.physics.position = {random_double(0, width), random_double(0, height)};
+        }
+    }
+    else if (distribution == "clustered") {
+        // swarms of about a thousand around random centers
+        std::vector<Vec<double>> centers(std::max(1, N / 1000));
+        for (Vec<double>& center : centers) {
+            center = {random_double(0, width), random_double(0, height)};
+        }
+        std::normal_distribution<double> spread{0, 3};
+        for (Entity& entity : scene.entities) {
+            const Vec<double>& center = centers[random_index(centers.size())];
+            entity.physics.position = clamp({center.x + spread(random_engine), center.y + spread(random_engine)});
+        }
+    }
+    else if (distribution == "line") {
+        // enemies standing on platforms 10 to 40 tiles long, so many share a y
+        struct Platform {
+            double x, y, length;
+        };
+        std::vector<Platform> platforms(std::max(1, N / 20));
+        for (Platform& platform : platforms) {
+            platform = {random_double(0, width), std::floor(random_double(0, height)), random_double(10, 40)};
+        }
+        for (Entity& entity : scene.entities) {
+            const Platform& platform = platforms[random_index(platforms.size())];
+            entity.physics.position = clamp({platform.x + random_double(0, platform.length), platform.y});
+        }
+    }
+    else {
+        throw std::runtime_error("Unknown distribution: " + distribution);
+    }
+
+    // a third stand still, the rest walk a few tiles per second
+    scene.velocities.resize(N);
+    for (int i = 0; i < N; ++i) {
+        if (i % 3 != 0) {
+            scene.velocities[i] = {random_double(-5, 5), 0};
+        }
+    }
+    return scene;
+}
+
+void step(Scene& scene, double dt) {
+    for (std::size_t i = 0; i < scene.entities.size(); ++i) {
+        Vec<double>& position = scene.entities[i].physics.position;
+        position += scene.velocities[i] * dt;
+        if (position.x <= 0 || position.x >= scene.width - 1) {
+            scene.velocities[i].x = -scene.velocities[i].x;
+            position.x = std::clamp(position.x, 0.0, scene.width - 1);
+        }
+    }
+}
+
+// run setup then operation warmup + reps times, timing and counting only the
+// operation, and print a row. operation_body makes ops operations
+void measure(const std::string& structure, const Scene& scene, const std::string& operation, int reps, int ops,
+             const std::function<void()>& setup, const std::function<void()>& operation_body) {
+    int warmup = std::max(1, reps / 5);
+    std::vector<double> times;
+    std::size_t allocated{0};
     Timer timer;
-    timer.start();
+    for (int rep = 0; rep < warmup + reps; ++rep) {
+        setup();
+        std::size_t before = allocations;
+        timer.start();
+        operation_body();
+        double elapsed = timer.stop();
+        std::size_t made = allocations - before;
+        if (rep >= warmup) {
+            times.push_back(elapsed);
+            allocated += made;
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    double p95 = times[std::min(times.size() - 1, static_cast<std::size_t>(std::ceil(0.95 * times.size())) - 1)];
+    std::cout << structure << ',' << scene.distribution << ',' << scene.entities.size() << ',' << operation << ','
+              << reps << ',' << ops << ',' << median << ',' << p95 << ','
+              << static_cast<double>(allocated) / reps / ops << std::endl;
+}
 
-    for (int i = 0; i < 100; ++i) {
+void benchmark(const std::string& distribution, int N) {
+    Scene scene = make_scene(distribution, N);
+    std::vector<Entity>& entities = scene.entities;
+    int reps = std::clamp(2000000 / N, 5, 50);
+    double dt = 1.0 / 60.0;
+    auto nothing = []() {};
+
+    // queries are centered on enemies, like the player and projectiles are
+    constexpr int queries = 1000;
+    std::vector<Vec<double>> centers(queries), directions(queries);
+    for (int i = 0; i < queries; ++i) {
+        centers[i] = entities[random_index(N)].physics.position;
+        double angle = random_double(0, 2 * M_PI);
+        directions[i] = {std::cos(angle), std::sin(angle)};
+    }
+    std::vector<Entity*> found;
+    found.reserve(N);
+    std::size_t sink{0};
+
+    // the tree as World uses it: loose, and kept up to date incrementally
+    QuadTree quadtree{scene.boundary(), true};
+    std::vector<Vec<double>> indexed(N);
+    auto rebuild = [&]() {
         quadtree.clear();
-        for (const auto& point : points) {
-            quadtree.insert(point);
+        for (int i = 0; i < N; ++i) {
+            quadtree.insert(&entities[i]);
+            indexed[i] = entities[i].physics.position;
         }
+    };
+    measure("quadtree", scene, "build", reps, N, nothing, rebuild);
+    std::vector<Entity*> pointers;
+    for (Entity& entity : entities) {
+        pointers.push_back(&entity);
     }
-    double elapsed = timer.stop() / 100;
-    std::cout << "Build time: " << elapsed << "\n";
+    measure("quadtree", scene, "parallel_build", reps, N, nothing, [&]() {
+        quadtree.build(pointers);
+    });
+    rebuild();
+    measure("quadtree", scene, "update", reps, N, [&]() {step(scene, dt);}, [&]() {
+        for (int i = 0; i < N; ++i) {
+            quadtree.update(&entities[i], indexed[i]);
+            indexed[i] = entities[i].physics.position;
+        }
+    });
+    measure("quadtree", scene, "range", reps, queries, nothing, [&]() {
+        for (const Vec<double>& center : centers) {
+            found.clear();
+            quadtree.query_range(AABB{center, {2, 2}}, found);
+            sink += found.size();
+        }
+    });
+    measure("quadtree", scene, "radius", reps, queries, nothing, [&]() {
+        for (const Vec<double>& center : centers) {
+            found.clear();
+            quadtree.query_radius(center, 3, found);
+            sink += found.size();
+        }
+    });
+    std::vector<QuadTree::Candidate> candidates;
+    measure("quadtree", scene, "nearest", reps, queries, nothing, [&]() {
+        for (const Vec<double>& center : centers) {
+            found.clear();
+            quadtree.nearest(center, 4, found, candidates);
+            sink += found.size();
+        }
+    });
+    measure("quadtree", scene, "raycast", reps, queries, nothing, [&]() {
+        for (int i = 0; i < queries; ++i) {
+            sink += quadtree.raycast(centers[i] + directions[i] * 2.0, directions[i], 20).has_value();
+        }
+    });
 
-    timer.start();
-    for (int i = 0; i < 100; ++i) {
-        AABB search_range{{200, 300}, {100, 100}};
-        auto found = quadtree.query_range(search_range);
+    LinearQuadTree linear{scene.boundary()};
+    measure("linear", scene, "build", reps, N, nothing, [&]() {
+        linear.clear();
+        for (Entity& entity : entities) {
+            linear.insert(&entity);
+        }
+        linear.build();
+    });
+    measure("linear", scene, "range", reps, queries, nothing, [&]() {
+        for (const Vec<double>& center : centers) {
+            found.clear();
+            linear.query_range(AABB{center, {2, 2}}, found);
+            sink += found.size();
+        }
+    });
+
+    SpatialHashGrid grid;
+    measure("grid", scene, "build", reps, N, nothing, [&]() {
+        grid.clear();
+        for (int i = 0; i < N; ++i) {
+            grid.insert(&entities[i]);
+            indexed[i] = entities[i].physics.position;
+        }
+    });
+    measure("grid", scene, "update", reps, N, [&]() {step(scene, dt);}, [&]() {
+        for (int i = 0; i < N; ++i) {
+            grid.update(&entities[i], indexed[i]);
+            indexed[i] = entities[i].physics.position;
+        }
+    });
+    measure("grid", scene, "range", reps, queries, nothing, [&]() {
+        for (const Vec<double>& center : centers) {
+            found.clear();
+            grid.query_range(AABB{center, {2, 2}}, found);
+            sink += found.size();
+        }
+    });
+
+    // keep the queries from being optimized away
+    if (sink == 0) {
+        std::cerr << "no query found anything\n";
     }
-    elapsed = timer.stop() / 100;
-    std::cout << "Search time: " << elapsed << "\n";
 }
 
+int main(int argc, char* argv[]) {
+    int max_n = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+    std::cout << "structure,distribution,n,operation,reps,ops,median_s,p95_s,allocations" << std::endl;
+    for (const std::string distribution : {"uniform", "clustered", "line"}) {
+        for (int N : {100, 1000, 10000, 100000, 1000000}) {
+            if (N <= max_n) {
+                benchmark(distribution, N);
+            }
+        }
+    }
+}
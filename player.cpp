@@ -3,8 +3,8 @@
 #include "combat.h"
 #include <iostream>
 
-Player::Player(Engine& engine, const Vec<double>& position, const Vec<int>& size)
-    :size{size} {
+Player::Player(Engine& engine, const Vec<double>& position, const Vec<int>& size) {
+        this->size = size;
         physics.position = position;
         physics.acceleration.y = gravity;
         combat.health = 20;
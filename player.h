@@ -22,7 +22,6 @@ public:
     std::pair<Vec<double>, Color> get_sprite() const;
     const double walk_acceleration = 80.0;
     const double jump_velocity = 16;
-    Vec<int> size;
     Color color{255, 0, 0, 255};
     AnimatedSprite standing;
     AnimatedSprite standing_carrying_g;
@@ -9,19 +9,10 @@ void Projectile::update(Engine& engine, double dt) {
     anim_sprite.update(dt);
     sprite = anim_sprite.get_sprite();
 
-    // Check for collisions
-    Vec<double> future{physics.position.x, old.position.y};
-    Vec<double> vx{physics.velocity.x, 0};
-    engine.world->move_to(future, size, vx);
-
-    // attempt to move in y
-    Vec<double> vy{0, physics.velocity.y};
-    future.y = physics.position.y;
-    engine.world->move_to(future, size, vy);
-
-    // update postion & velocity
-    physics.position = future;
-    physics.velocity = {vx.x, vy.y};
+    // move from where it was, stopping at walls
+    Vec<double> position = old.position;
+    engine.world->move_by(position, size, physics.velocity, physics.position - old.position);
+    physics.position = position;
 
     if (physics.velocity.x == 0 || hit_enemy) {
         if (elapsed == 0 && !hit_enemy) {
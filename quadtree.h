@@ -1,31 +1,903 @@
 #pragma once
 
-#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include "vec.h"
+#include "aabb.h"
+#include "entity.h"
 
-class Entity;
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-// rectangular AABB
-struct AABB {
-    Vec<double> center, half_dimension;
+// How a quadtree reads the objects it stores: where each one is, and for a
+// loose tree how far it reaches up and to the right from there.
+struct EntityAccessor {
+    Vec<double> position(const Entity* entity) const {
+        return entity->physics.position;
+    }
+    Vec<double> size(const Entity* entity) const {
+        return {static_cast<double>(entity->size.x), static_cast<double>(entity->size.y)};
+    }
+};
 
-    bool contains(const Vec<double>& point) const;
-    bool intersects(const AABB& other) const;
+struct PointAccessor {
+    Vec<double> position(const Vec<double>& point) const {
+        return point;
+    }
+    Vec<double> size(const Vec<double>&) const {
+        return {0, 0};
+    }
 };
 
-class QuadTree {
+// Nodes and buckets of objects live in pools indexed by int, so clear() only
+// resets the pools and rebuilding the tree every tick reuses their storage.
+//
+// By default an object is a point at its position. A loose tree indexes
+// each object's box instead: the box is stored in the smallest node whose
+// bounds, doubled, still hold it, so queries return every object whose body
+// overlaps the range.
+//
+// Objects are stored by value and found again with ==, so remove and update
+// want T to be a handle such as a pointer. Leaves at MaxDepth keep every
+// object they are given, which is what stops coincident points from
+// splitting forever.
+template <typename T, typename Accessor, std::size_t Capacity = 4, int MaxDepth = 16, typename Scalar = double>
+class BasicQuadTree {
+    static_assert(std::is_floating_point_v<Scalar>, "quadtree coordinates must be floating point");
+    static_assert(Capacity > 0, "nodes must hold at least one object");
+
 public:
-    QuadTree(AABB boundary);
+    using Box = BasicAABB<Scalar>;
+    using Point = Vec<Scalar>;
+
+    BasicQuadTree(Box boundary, bool loose = false, Accessor accessor = {});
 
     void clear();
-    void subdivide();
-    std::vector<Entity*> query_range(AABB range) const;
+    std::vector<T> query_range(Box range) const;
+
+    // allocation free queries: call visit(object) for each match, or append
+    // matches to a caller owned buffer (it is not cleared first)
+    template <typename Visitor>
+    void query_range(const Box& range, Visitor&& visit) const;
+    void query_range(const Box& range, std::vector<T>& results) const;
+    template <typename Predicate>
+    void query_range(const Box& range, std::vector<T>& results, Predicate predicate) const;
+
+    // objects within radius of center, measured to the nearest point of
+    // each object's box, so a loose tree catches bodies the circle grazes
+    std::vector<T> query_radius(const Point& center, Scalar radius) const;
+    template <typename Visitor>
+    void query_radius(const Point& center, Scalar radius, Visitor&& visit) const;
+    void query_radius(const Point& center, Scalar radius, std::vector<T>& results) const;
+
+    // append the k objects closest to point, nearest first, skipping those
+    // the predicate rejects. Nodes are opened in order of distance, so only
+    // the neighbourhood of the answer is visited. The search queues nodes
+    // and objects in a caller owned scratch heap, which keeps its capacity
+    // between calls so repeated queries don't allocate
+    struct Candidate {
+        Scalar distance_squared;
+        int node;
+        const T* object; // null for a node still to open
+    };
+    void nearest(const Point& point, std::size_t k, std::vector<T>& results) const;
+    void nearest(const Point& point, std::size_t k, std::vector<T>& results, std::vector<Candidate>& scratch) const;
+    template <typename Predicate>
+    void nearest(const Point& point, std::size_t k, std::vector<T>& results, std::vector<Candidate>& scratch,
+                 Predicate predicate) const;
+
+    // the first object a segment from origin hits, and how far along it is.
+    // Only nodes the segment crosses are opened, nearest first, and the
+    // search stops once nothing left can be closer than the best hit
+    struct RayHit {
+        T object;
+        Scalar distance;
+    };
+    std::optional<RayHit> raycast(const Point& origin, const Point& direction, Scalar max_distance) const;
+    template <typename Predicate>
+    std::optional<RayHit> raycast(const Point& origin, const Point& direction, Scalar max_distance,
+                                  Predicate predicate) const;
+
+    bool insert(const T& object);
+
+    // clear and insert everything at once. Big batches are split by root
+    // quadrant and the four subtrees are built on up to threads threads,
+    // then grafted under the root
+    void build(const std::vector<T>& objects, unsigned threads = std::thread::hardware_concurrency());
+    static constexpr std::size_t PARALLEL_BUILD_MIN = 20000; // below this threads cost more than they save
+
+    // incremental maintenance: old_position is where the object was inserted,
+    // only objects that move into a different leaf are relinked
+    bool remove(const T& object, const Point& old_position);
+    bool update(const T& object, const Point& old_position);
+
+    static constexpr std::size_t NODE_CAPACITY = Capacity;
+    static constexpr int MAX_DEPTH = MaxDepth; // leaves this deep keep every object, even past capacity
+    static constexpr int NONE = -1;
+
+    // boxes the query filter tests per instruction: AVX or SSE2 registers
+    // when the compiler targets them, one at a time otherwise
+#if defined(__AVX__)
+    static constexpr std::size_t LANES = 32 / sizeof(Scalar);
+#elif defined(__SSE2__)
+    static constexpr std::size_t LANES = 16 / sizeof(Scalar);
+#else
+    static constexpr std::size_t LANES = 1;
+#endif
+    static constexpr std::size_t PADDED_CAPACITY = (NODE_CAPACITY + LANES - 1) / LANES * LANES;
+
+    struct Node {
+        Box boundary; // loose trees test queries against twice this size
+        int first_child{NONE}; // children are stored together: nw, ne, sw, se
+        int bucket{NONE}; // only the first bucket of the chain can be partly full
+        std::size_t count{0};
+        int depth{0};
+    };
+
+    // a node's objects sit next to each other, along with the box each one
+    // had when it was indexed. The boxes are stored a component at a time so
+    // a query loads LANES of them at once without touching the objects
+    struct Bucket {
+        T objects[NODE_CAPACITY];
+        alignas(32) Scalar center_x[PADDED_CAPACITY];
+        alignas(32) Scalar center_y[PADDED_CAPACITY];
+        alignas(32) Scalar half_x[PADDED_CAPACITY];
+        alignas(32) Scalar half_y[PADDED_CAPACITY];
+        std::size_t count;
+        int next;
+
+        Box box(std::size_t i) const {
+            return Box{{center_x[i], center_y[i]}, {half_x[i], half_y[i]}};
+        }
+        void set(std::size_t i, const T& object, const Box& box) {
+            objects[i] = object;
+            center_x[i] = box.center.x;
+            center_y[i] = box.center.y;
+            half_x[i] = box.half_dimension.x;
+            half_y[i] = box.half_dimension.y;
+        }
+    };
+
+    Box boundary;
+    bool loose;
+    Accessor accessor;
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<Bucket> buckets;
+
+private:
+    // released slots are reused before the pools grow
+    int free_nodes{NONE}; // blocks of four, linked through first_child
+    int free_buckets{NONE}; // linked through next
+
+    Box box_for(const T& object, const Point& position) const;
+    void insert_at(int node, const T& object, const Box& box);
+    void graft(int slot, BasicQuadTree& subtree);
+    void add(int node, T object, Box box); // by value, the pool may grow
+    bool remove_from(int node, const T& object);
+    void release_buckets(int node);
+    void subdivide(int node);
+    bool remove(int node, const T& object, const Box& old_box);
+    void merge(int node);
+    int child_for(int node, const Box& box) const;
+    Box search_bounds(int node) const;
+    static unsigned overlap_mask(const Bucket& b, std::size_t first, const Box& range);
+    template <typename Visitor>
+    void visit_range(int node, const Box& range, Visitor& visit) const;
+    template <typename Visitor>
+    void visit_radius(int node, const Point& center, Scalar radius_squared, Visitor& visit) const;
+    template <typename Predicate>
+    void visit_ray(int node, const Point& origin, const Point& direction, std::optional<RayHit>& best,
+                   Scalar& best_distance, Predicate& predicate) const;
+    static Scalar entry_distance(const Box& box, const Point& origin, const Point& direction, Scalar limit);
+};
+
+// the tree the game indexes its entities with
+using QuadTree = BasicQuadTree<Entity*, EntityAccessor>;
+
+// bare points, for the demos
+using PointQuadTree = BasicQuadTree<Vec<double>, PointAccessor>;
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::BasicQuadTree(Box boundary, bool loose, Accessor accessor)
+    :boundary{boundary}, loose{loose}, accessor{accessor} {
+    clear();
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::clear() {
+    // both pools keep their capacity, so the next build doesn't allocate
+    nodes.clear();
+    buckets.clear();
+    free_nodes = NONE;
+    free_buckets = NONE;
+    nodes.push_back(Node{boundary});
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+bool BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::insert(const T& object) {
+    Box box = box_for(object, accessor.position(object));
+
+    // ignore objects that don't belong
+    if (!boundary.contains(box.center)) {
+        return false;
+    }
+    insert_at(0, object, box);
+    return true;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::insert_at(int node, const T& object, const Box& box) {
+    while (true) {
+        if (nodes[node].first_child == NONE) {
+            // if there is space and no children then object is stored
+            if (nodes[node].count < NODE_CAPACITY || nodes[node].depth == MAX_DEPTH) {
+                add(node, object, box);
+                return;
+            }
+
+            // otherwise subdivide and insert into children
+            subdivide(node);
+        }
+
+        // objects too big for any child stay in the parent
+        int child = child_for(node, box);
+        if (child == NONE) {
+            add(node, object, box);
+            return;
+        }
+        node = child;
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::build(const std::vector<T>& objects, unsigned threads) {
+    clear();
+    if (threads < 2 || objects.size() < PARALLEL_BUILD_MIN) {
+        for (const T& object : objects) {
+            insert(object);
+        }
+        return;
+    }
+
+    // split the root by hand and sort the objects into its quadrants, the
+    // ones too big for any quadrant stay in the root like insert would leave them
+    subdivide(0);
+    int first_child = nodes[0].first_child;
+    std::vector<std::pair<T, Box>> quadrants[4];
+    for (const T& object : objects) {
+        Box box = box_for(object, accessor.position(object));
+        if (!boundary.contains(box.center)) {
+            continue;
+        }
+        int child = child_for(0, box);
+        if (child == NONE) {
+            add(0, object, box);
+        }
+        else {
+            quadrants[child - first_child].emplace_back(object, box);
+        }
+    }
+
+    // each quadrant is a tree of its own until it is grafted back
+    std::vector<BasicQuadTree> subtrees;
+    subtrees.reserve(4);
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        subtrees.emplace_back(nodes[first_child + quadrant].boundary, loose, accessor);
+        subtrees.back().nodes[0].depth = 1;
+    }
+    unsigned workers = std::min(threads, 4u);
+    auto build_quadrants = [&](unsigned worker) {
+        for (unsigned quadrant = worker; quadrant < 4; quadrant += workers) {
+            for (const auto& [object, box] : quadrants[quadrant]) {
+                subtrees[quadrant].insert_at(0, object, box);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned worker = 1; worker < workers; ++worker) {
+        pool.emplace_back(build_quadrants, worker);
+    }
+    build_quadrants(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        graft(first_child + quadrant, subtrees[quadrant]);
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::graft(int slot, BasicQuadTree& subtree) {
+    // the subtree's root replaces nodes[slot], the rest of its nodes and all
+    // of its buckets are appended, so every index is shifted to match
+    int node_offset = static_cast<int>(nodes.size()) - 1;
+    int bucket_offset = static_cast<int>(buckets.size());
+    auto node_index = [&](int index) {
+        return index == NONE ? NONE : (index == 0 ? slot : node_offset + index);
+    };
+    auto bucket_index = [&](int index) {
+        return index == NONE ? NONE : bucket_offset + index;
+    };
+
+    for (Bucket& bucket : subtree.buckets) {
+        bucket.next = bucket_index(bucket.next);
+    }
+    buckets.insert(buckets.end(), subtree.buckets.begin(), subtree.buckets.end());
+    for (std::size_t i = 0; i < subtree.nodes.size(); ++i) {
+        Node node = subtree.nodes[i];
+        node.first_child = node_index(node.first_child);
+        node.bucket = bucket_index(node.bucket);
+        if (i == 0) {
+            nodes[slot] = node;
+        }
+        else {
+            nodes.push_back(node);
+        }
+    }
+
+    // slots the subtree released join our free lists
+    if (subtree.free_buckets != NONE) {
+        int tail = bucket_index(subtree.free_buckets);
+        while (buckets[tail].next != NONE) {
+            tail = buckets[tail].next;
+        }
+        buckets[tail].next = free_buckets;
+        free_buckets = bucket_index(subtree.free_buckets);
+    }
+    if (subtree.free_nodes != NONE) {
+        int tail = node_index(subtree.free_nodes);
+        while (nodes[tail].first_child != NONE) {
+            tail = nodes[tail].first_child;
+        }
+        nodes[tail].first_child = free_nodes;
+        free_nodes = node_index(subtree.free_nodes);
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+bool BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::remove(const T& object, const Point& old_position) {
+    Box old_box = box_for(object, old_position);
+    if (!boundary.contains(old_box.center)) {
+        return false;
+    }
+    return remove(0, object, old_box);
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+bool BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::update(const T& object, const Point& old_position) {
+    Point position = accessor.position(object);
+    Box box = box_for(object, position);
+    if (position == old_position) {
+        // standing still, nothing to touch
+        return boundary.contains(box.center);
+    }
+
+    Box old_box = box_for(object, old_position);
+    if (boundary.contains(old_box.center) && boundary.contains(box.center)) {
+        // walk down while both boxes belong to the same node
+        int node = 0;
+        bool same_node = true;
+        while (nodes[node].first_child != NONE) {
+            int child = child_for(node, old_box);
+            if (child != child_for(node, box)) {
+                same_node = false;
+                break;
+            }
+            if (child == NONE) {
+                break;
+            }
+            node = child;
+        }
+
+        // same node, only the stored box changes
+        for (int bucket = nodes[node].bucket; same_node && bucket != NONE; bucket = buckets[bucket].next) {
+            Bucket& b = buckets[bucket];
+            for (std::size_t i = 0; i < b.count; ++i) {
+                if (b.objects[i] == object) {
+                    b.set(i, object, box);
+                    return true;
+                }
+            }
+        }
+    }
+
+    remove(object, old_position);
+    return insert(object);
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+auto BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::box_for(const T& object, const Point& position) const -> Box {
+    if (!loose) {
+        return Box{position, {0, 0}};
+    }
+    Point half = accessor.size(object) / Scalar{2};
+    return Box{position + half, half};
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::add(int node, T object, Box box) {
+    int head = nodes[node].bucket;
+    if (head == NONE || buckets[head].count == NODE_CAPACITY) {
+        // start a new bucket at the front of the chain
+        int bucket = free_buckets;
+        if (bucket != NONE) {
+            free_buckets = buckets[bucket].next;
+        }
+        else {
+            bucket = buckets.size();
+            buckets.emplace_back();
+        }
+        buckets[bucket].count = 0;
+        buckets[bucket].next = head;
+        nodes[node].bucket = head = bucket;
+    }
+
+    Bucket& b = buckets[head];
+    b.set(b.count, object, box);
+    ++b.count;
+    ++nodes[node].count;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+bool BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::remove_from(int node, const T& object) {
+    for (int bucket = nodes[node].bucket; bucket != NONE; bucket = buckets[bucket].next) {
+        Bucket& b = buckets[bucket];
+        for (std::size_t i = 0; i < b.count; ++i) {
+            if (!(b.objects[i] == object)) {
+                continue;
+            }
+
+            // fill the hole with the last object of the head bucket
+            int head = nodes[node].bucket;
+            Bucket& h = buckets[head];
+            --h.count;
+            b.set(i, h.objects[h.count], h.box(h.count));
+            if (h.count == 0) {
+                nodes[node].bucket = h.next;
+                h.next = free_buckets;
+                free_buckets = head;
+            }
+            --nodes[node].count;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::release_buckets(int node) {
+    int bucket = nodes[node].bucket;
+    while (bucket != NONE) {
+        int next = buckets[bucket].next;
+        buckets[bucket].next = free_buckets;
+        free_buckets = bucket;
+        bucket = next;
+    }
+    nodes[node].bucket = NONE;
+    nodes[node].count = 0;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::subdivide(int node) {
+    Box parent = nodes[node].boundary;
+    Point half = parent.half_dimension / Scalar{2};
+    int depth = nodes[node].depth + 1;
+
+    Node children[4] = {
+        Node{Box{{parent.center.x - half.x, parent.center.y + half.y}, half}, NONE, NONE, 0, depth},
+        Node{Box{{parent.center.x + half.x, parent.center.y + half.y}, half}, NONE, NONE, 0, depth},
+        Node{Box{{parent.center.x - half.x, parent.center.y - half.y}, half}, NONE, NONE, 0, depth},
+        Node{Box{{parent.center.x + half.x, parent.center.y - half.y}, half}, NONE, NONE, 0, depth}
+    };
+
+    int first_child = free_nodes;
+    if (first_child != NONE) {
+        free_nodes = nodes[first_child].first_child;
+        std::copy(std::begin(children), std::end(children), nodes.begin() + first_child);
+    }
+    else {
+        first_child = nodes.size();
+        nodes.insert(nodes.end(), std::begin(children), std::end(children));
+    }
+    nodes[node].first_child = first_child;
+
+    // hand the stored objects down to the children that can hold them
+    int stored = nodes[node].bucket;
+    nodes[node].bucket = NONE;
+    nodes[node].count = 0;
+    for (int bucket = stored; bucket != NONE; bucket = buckets[bucket].next) {
+        for (std::size_t i = 0; i < buckets[bucket].count; ++i) {
+            Box box = buckets[bucket].box(i);
+            int child = child_for(node, box);
+            add(child == NONE ? node : child, buckets[bucket].objects[i], box);
+        }
+    }
+    while (stored != NONE) {
+        int next = buckets[stored].next;
+        buckets[stored].next = free_buckets;
+        free_buckets = stored;
+        stored = next;
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+bool BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::remove(int node, const T& object, const Box& old_box) {
+    bool leaf = nodes[node].first_child == NONE;
+    if (!remove_from(node, object)) {
+        int child = leaf ? NONE : child_for(node, old_box);
+        if (child == NONE || !remove(child, object, old_box)) {
+            return false;
+        }
+    }
+    if (!leaf) {
+        merge(node);
+    }
+    return true;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::merge(int node) {
+    // only collapse parents of leaves once they are half empty, so an object
+    // moving back and forth across a boundary doesn't split and merge each tick
+    int first_child = nodes[node].first_child;
+    std::size_t count = nodes[node].count;
+    for (int child = first_child; child < first_child + 4; ++child) {
+        if (nodes[child].first_child != NONE) {
+            return;
+        }
+        count += nodes[child].count;
+    }
+    if (count > NODE_CAPACITY / 2) {
+        return;
+    }
+
+    nodes[node].first_child = NONE;
+    for (int child = first_child; child < first_child + 4; ++child) {
+        for (int bucket = nodes[child].bucket; bucket != NONE; bucket = buckets[bucket].next) {
+            for (std::size_t i = 0; i < buckets[bucket].count; ++i) {
+                add(node, buckets[bucket].objects[i], buckets[bucket].box(i));
+            }
+        }
+        release_buckets(child);
+    }
+
+    nodes[first_child].first_child = free_nodes;
+    free_nodes = first_child;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+int BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::child_for(int node, const Box& box) const {
+    const Box& parent = nodes[node].boundary;
+    int quadrant = (box.center.y < parent.center.y ? 2 : 0) + (box.center.x < parent.center.x ? 0 : 1);
+
+    // a child's loose bounds are twice its size, so a box centered inside it
+    // fits as long as it is no bigger than the child itself
+    Point child_half = parent.half_dimension / Scalar{2};
+    if (box.half_dimension.x > child_half.x || box.half_dimension.y > child_half.y) {
+        return NONE;
+    }
+    return nodes[node].first_child + quadrant;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+auto BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::search_bounds(int node) const -> Box {
+    // loose nodes hold objects that reach out to twice their size
+    Box bounds = nodes[node].boundary;
+    if (loose) {
+        bounds.half_dimension = bounds.half_dimension * Scalar{2};
+    }
+    return bounds;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+unsigned BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::overlap_mask(const Bucket& b, std::size_t first,
+                                                                             const Box& range) {
+    // bit i is set when the range overlaps box first + i, same test as
+    // AABB::intersects: |dx| < half widths summed, on both axes. Lanes past
+    // count hold stale boxes, callers skip them
+#if defined(__AVX__)
+    if constexpr (std::is_same_v<Scalar, double>) {
+        __m256d sign = _mm256_set1_pd(-0.0);
+        __m256d dx = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_load_pd(b.center_x + first), _mm256_set1_pd(range.center.x)));
+        __m256d dy = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_load_pd(b.center_y + first), _mm256_set1_pd(range.center.y)));
+        __m256d wx = _mm256_add_pd(_mm256_load_pd(b.half_x + first), _mm256_set1_pd(range.half_dimension.x));
+        __m256d wy = _mm256_add_pd(_mm256_load_pd(b.half_y + first), _mm256_set1_pd(range.half_dimension.y));
+        return _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(dx, wx, _CMP_LT_OQ), _mm256_cmp_pd(dy, wy, _CMP_LT_OQ)));
+    }
+    else if constexpr (std::is_same_v<Scalar, float>) {
+        __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 dx = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_load_ps(b.center_x + first), _mm256_set1_ps(range.center.x)));
+        __m256 dy = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_load_ps(b.center_y + first), _mm256_set1_ps(range.center.y)));
+        __m256 wx = _mm256_add_ps(_mm256_load_ps(b.half_x + first), _mm256_set1_ps(range.half_dimension.x));
+        __m256 wy = _mm256_add_ps(_mm256_load_ps(b.half_y + first), _mm256_set1_ps(range.half_dimension.y));
+        return _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(dx, wx, _CMP_LT_OQ), _mm256_cmp_ps(dy, wy, _CMP_LT_OQ)));
+    }
+#elif defined(__SSE2__)
+    if constexpr (std::is_same_v<Scalar, double>) {
+        __m128d sign = _mm_set1_pd(-0.0);
+        __m128d dx = _mm_andnot_pd(sign, _mm_sub_pd(_mm_load_pd(b.center_x + first), _mm_set1_pd(range.center.x)));
+        __m128d dy = _mm_andnot_pd(sign, _mm_sub_pd(_mm_load_pd(b.center_y + first), _mm_set1_pd(range.center.y)));
+        __m128d wx = _mm_add_pd(_mm_load_pd(b.half_x + first), _mm_set1_pd(range.half_dimension.x));
+        __m128d wy = _mm_add_pd(_mm_load_pd(b.half_y + first), _mm_set1_pd(range.half_dimension.y));
+        return _mm_movemask_pd(_mm_and_pd(_mm_cmplt_pd(dx, wx), _mm_cmplt_pd(dy, wy)));
+    }
+    else if constexpr (std::is_same_v<Scalar, float>) {
+        __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 dx = _mm_andnot_ps(sign, _mm_sub_ps(_mm_load_ps(b.center_x + first), _mm_set1_ps(range.center.x)));
+        __m128 dy = _mm_andnot_ps(sign, _mm_sub_ps(_mm_load_ps(b.center_y + first), _mm_set1_ps(range.center.y)));
+        __m128 wx = _mm_add_ps(_mm_load_ps(b.half_x + first), _mm_set1_ps(range.half_dimension.x));
+        __m128 wy = _mm_add_ps(_mm_load_ps(b.half_y + first), _mm_set1_ps(range.half_dimension.y));
+        return _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(dx, wx), _mm_cmplt_ps(dy, wy)));
+    }
+#endif
+    unsigned mask = 0;
+    for (std::size_t lane = 0; lane < LANES; ++lane) {
+        if (range.intersects(b.box(first + lane))) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+std::vector<T> BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_range(Box range) const {
+    std::vector<T> results;
+    query_range(range, results);
+    return results;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_range(const Box& range, std::vector<T>& results) const {
+    query_range(range, [&](const T& object) {
+        results.push_back(object);
+    });
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Visitor>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_range(const Box& range, Visitor&& visit) const {
+    visit_range(0, range, visit);
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Predicate>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_range(const Box& range, std::vector<T>& results,
+                                                                         Predicate predicate) const {
+    query_range(range, [&](const T& object) {
+        if (predicate(object)) {
+            results.push_back(object);
+        }
+    });
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Visitor>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::visit_range(int node, const Box& range, Visitor& visit) const {
+    if (!search_bounds(node).intersects(range)) {
+        return;
+    }
+
+    // objects stored in this node, only leaves have them in a point tree
+    for (int bucket = nodes[node].bucket; bucket != NONE; bucket = buckets[bucket].next) {
+        const Bucket& b = buckets[bucket];
+        for (std::size_t first = 0; first < b.count; first += LANES) {
+            unsigned mask = overlap_mask(b, first, range);
+            for (std::size_t lane = 0; mask != 0 && lane < LANES; ++lane, mask >>= 1) {
+                if ((mask & 1) && first + lane < b.count) {
+                    visit(b.objects[first + lane]);
+                }
+            }
+        }
+    }
+
+    // handle parent nodes
+    if (nodes[node].first_child != NONE) {
+        for (int child = nodes[node].first_child; child < nodes[node].first_child + 4; ++child) {
+            visit_range(child, range, visit);
+        }
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+std::vector<T> BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_radius(const Point& center, Scalar radius) const {
+    std::vector<T> results;
+    query_radius(center, radius, results);
+    return results;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_radius(const Point& center, Scalar radius,
+                                                                          std::vector<T>& results) const {
+    query_radius(center, radius, [&](const T& object) {
+        results.push_back(object);
+    });
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Visitor>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::query_radius(const Point& center, Scalar radius,
+                                                                          Visitor&& visit) const {
+    visit_radius(0, center, radius * radius, visit);
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Visitor>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::visit_radius(int node, const Point& center,
+                                                                          Scalar radius_squared, Visitor& visit) const {
+    if (search_bounds(node).distance_squared(center) > radius_squared) {
+        return;
+    }
+
+    for (int bucket = nodes[node].bucket; bucket != NONE; bucket = buckets[bucket].next) {
+        const Bucket& b = buckets[bucket];
+        for (std::size_t i = 0; i < b.count; ++i) {
+            if (b.box(i).distance_squared(center) <= radius_squared) {
+                visit(b.objects[i]);
+            }
+        }
+    }
+
+    if (nodes[node].first_child != NONE) {
+        for (int child = nodes[node].first_child; child < nodes[node].first_child + 4; ++child) {
+            visit_radius(child, center, radius_squared, visit);
+        }
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::nearest(const Point& point, std::size_t k,
+                                                                     std::vector<T>& results) const {
+    std::vector<Candidate> scratch;
+    nearest(point, k, results, scratch, [](const T&) {return true;});
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::nearest(const Point& point, std::size_t k,
+                                                                     std::vector<T>& results,
+                                                                     std::vector<Candidate>& scratch) const {
+    nearest(point, k, results, scratch, [](const T&) {return true;});
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Predicate>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::nearest(const Point& point, std::size_t k,
+                                                                     std::vector<T>& results,
+                                                                     std::vector<Candidate>& scratch,
+                                                                     Predicate predicate) const {
+    auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.distance_squared > b.distance_squared;
+    };
+    auto push = [&](const Candidate& candidate) {
+        scratch.push_back(candidate);
+        std::push_heap(scratch.begin(), scratch.end(), farther);
+    };
+    scratch.clear();
+    push(Candidate{search_bounds(0).distance_squared(point), 0, nullptr});
+
+    // anything popped is no farther than everything left in the queue
+    std::size_t found = 0;
+    while (found < k && !scratch.empty()) {
+        std::pop_heap(scratch.begin(), scratch.end(), farther);
+        Candidate candidate = scratch.back();
+        scratch.pop_back();
+        if (candidate.object) {
+            results.push_back(*candidate.object);
+            ++found;
+            continue;
+        }
+
+        const Node& node = nodes[candidate.node];
+        for (int bucket = node.bucket; bucket != NONE; bucket = buckets[bucket].next) {
+            const Bucket& b = buckets[bucket];
+            for (std::size_t i = 0; i < b.count; ++i) {
+                if (predicate(b.objects[i])) {
+                    push(Candidate{b.box(i).distance_squared(point), NONE, &b.objects[i]});
+                }
+            }
+        }
+        if (node.first_child != NONE) {
+            for (int child = node.first_child; child < node.first_child + 4; ++child) {
+                push(Candidate{search_bounds(child).distance_squared(point), child, nullptr});
+            }
+        }
+    }
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+auto BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::raycast(const Point& origin, const Point& direction,
+                                                                     Scalar max_distance) const -> std::optional<RayHit> {
+    return raycast(origin, direction, max_distance, [](const T&) {return true;});
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Predicate>
+auto BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::raycast(const Point& origin, const Point& direction,
+                                                                     Scalar max_distance, Predicate predicate) const
+    -> std::optional<RayHit> {
+    Scalar length = std::hypot(direction.x, direction.y);
+    if (length == 0) {
+        return std::nullopt;
+    }
+    Point unit = direction / length;
+
+    std::optional<RayHit> best;
+    Scalar best_distance = max_distance;
+    if (entry_distance(search_bounds(0), origin, unit, max_distance) <= max_distance) {
+        visit_ray(0, origin, unit, best, best_distance, predicate);
+    }
+    return best;
+}
+
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+template <typename Predicate>
+void BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::visit_ray(int node, const Point& origin, const Point& direction,
+                                                                       std::optional<RayHit>& best, Scalar& best_distance,
+                                                                       Predicate& predicate) const {
+    for (int bucket = nodes[node].bucket; bucket != NONE; bucket = buckets[bucket].next) {
+        const Bucket& b = buckets[bucket];
+        for (std::size_t i = 0; i < b.count; ++i) {
+            Scalar distance = entry_distance(b.box(i), origin, direction, best_distance);
+            if (distance < best_distance && predicate(b.objects[i])) {
+                best = RayHit{b.objects[i], distance};
+                best_distance = distance;
+            }
+        }
+    }
+
+    if (nodes[node].first_child == NONE) {
+        return;
+    }
 
-    bool insert(Entity* object);
-    static constexpr std::size_t NODE_CAPACITY = 4;
+    // open the children the segment crosses in the order it enters them
+    std::pair<Scalar, int> children[4];
+    for (int i = 0; i < 4; ++i) {
+        int child = nodes[node].first_child + i;
+        children[i] = {entry_distance(search_bounds(child), origin, direction, best_distance), child};
+    }
+    std::sort(std::begin(children), std::end(children));
+    for (auto [distance, child] : children) {
+        if (distance >= best_distance) {
+            break;
+        }
+        visit_ray(child, origin, direction, best, best_distance, predicate);
+    }
+}
 
-    AABB boundary;
-    std::vector<Entity*> objects;
-    std::shared_ptr<QuadTree> nw, ne, sw, se;
-};
\ No newline at end of file
+template <typename T, typename Accessor, std::size_t Capacity, int MaxDepth, typename Scalar>
+Scalar BasicQuadTree<T, Accessor, Capacity, MaxDepth, Scalar>::entry_distance(const Box& box, const Point& origin,
+                                                                              const Point& direction, Scalar limit) {
+    // clip the segment [0, limit] against the box one axis (slab) at a time
+    Scalar enter = 0;
+    Scalar leave = limit;
+    Scalar starts[2] = {origin.x, origin.y};
+    Scalar steps[2] = {direction.x, direction.y};
+    Scalar centers[2] = {box.center.x, box.center.y};
+    Scalar halves[2] = {box.half_dimension.x, box.half_dimension.y};
+    for (int axis = 0; axis < 2; ++axis) {
+        if (steps[axis] == 0) {
+            // parallel to this slab, either always inside it or never
+            if (std::abs(starts[axis] - centers[axis]) > halves[axis]) {
+                return std::numeric_limits<Scalar>::infinity();
+            }
+            continue;
+        }
+        Scalar near = (centers[axis] - halves[axis] - starts[axis]) / steps[axis];
+        Scalar far = (centers[axis] + halves[axis] - starts[axis]) / steps[axis];
+        if (near > far) {
+            std::swap(near, far);
+        }
+        enter = std::max(enter, near);
+        leave = std::min(leave, far);
+        if (enter > leave) {
+            return std::numeric_limits<Scalar>::infinity();
+        }
+    }
+    return enter;
+}
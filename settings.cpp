@@ -21,4 +21,5 @@ void Settings::load() {
     load("screen_height", screen_height);
     load("tilesize", tilesize);
     load("starting_level", starting_level);
+    load_optional("broadphase", broadphase);
 }
@@ -13,6 +13,7 @@ public:
     int screen_width, screen_height, tilesize;
 
     std::string starting_level;
+    std::string broadphase{"quadtree"}; // optional, older settings files lack it
 private:
     void load();
     std::unordered_map<std::string, std::string> parameters;
@@ -27,4 +28,12 @@ private:
             throw std::runtime_error("Parameter '" + key + "' not found in " + filename);
         }
     }
+
+    // leaves value as it is when the key is missing
+    template <typename T>
+    void load_optional(const std::string& key, T& value) {
+        if (parameters.count(key)) {
+            load(key, value);
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "spatialhashgrid.h"
+#include <algorithm>
+#include <cmath>
+
+void SpatialHashGrid::clear() {
+    for (auto& [cell, elements] : cells) {
+        elements.clear();
+    }
+    max_size = {0, 0};
+}
+
+std::vector<Entity*> SpatialHashGrid::query_range(AABB range) const {
+    std::vector<Entity*> results;
+    query_range(range, results);
+    return results;
+}
+
+void SpatialHashGrid::query_range(const AABB& range, std::vector<Entity*>& results) const {
+    query_range(range, [&](Entity* object) {
+        results.push_back(object);
+    });
+}
+
+bool SpatialHashGrid::insert(Entity* object) {
+    max_size.x = std::max(max_size.x, object->size.x);
+    max_size.y = std::max(max_size.y, object->size.y);
+    cells[cell_for(object->physics.position)].push_back(Element{object, bounding_box(*object)});
+    return true;
+}
+
+bool SpatialHashGrid::remove(Entity* object, const Vec<double>& old_position) {
+    auto it = cells.find(cell_for(old_position));
+    if (it == cells.end()) {
+        return false;
+    }
+    std::vector<Element>& elements = it->second;
+    auto element = std::find_if(elements.begin(), elements.end(), [&](const Element& e){return e.object == object;});
+    if (element == elements.end()) {
+        return false;
+    }
+    *element = elements.back();
+    elements.pop_back();
+    return true;
+}
+
+bool SpatialHashGrid::update(Entity* object, const Vec<double>& old_position) {
+    Vec<int> cell = cell_for(object->physics.position);
+    if (cell == cell_for(old_position)) {
+        // same cell, only the stored box changes
+        for (Element& element : cells[cell]) {
+            if (element.object == object) {
+                element.box = bounding_box(*object);
+                return true;
+            }
+        }
+    }
+
+    remove(object, old_position);
+    return insert(object);
+}
+
+Vec<int> SpatialHashGrid::cell_for(const Vec<double>& position) {
+    return {static_cast<int>(std::floor(position.x)), static_cast<int>(std::floor(position.y))};
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "vec.h"
+#include "aabb.h"
+#include "entity.h"
+
+// A uniform grid of one tile cells, stored sparsely. Each object is kept in
+// the cell under its physics.position (its bottom left corner) along with
+// its bounding_box, and queries return every object whose body overlaps the
+// range, same as a loose QuadTree. Cheap to build and update when entities
+// are about a tile in size.
+class SpatialHashGrid {
+public:
+    void clear();
+    std::vector<Entity*> query_range(AABB range) const;
+
+    // allocation free queries: call visit(object) for each match, or append
+    // matches to a caller owned buffer (it is not cleared first)
+    template <typename Visitor>
+    void query_range(const AABB& range, Visitor&& visit) const;
+    void query_range(const AABB& range, std::vector<Entity*>& results) const;
+    template <typename Predicate>
+    void query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const;
+
+    bool insert(Entity* object);
+
+    // old_position is where the object was inserted, only objects that
+    // cross into a different cell are moved
+    bool remove(Entity* object, const Vec<double>& old_position);
+    bool update(Entity* object, const Vec<double>& old_position);
+
+    struct Element {
+        Entity* object;
+        AABB box;
+    };
+
+    // emptied cells keep their storage for the next objects to land there
+    std::unordered_map<Vec<int>, std::vector<Element>> cells;
+
+private:
+    // the biggest object indexed since clear(), queries reach down and left
+    // by this much to find objects whose cell is outside the range
+    Vec<int> max_size{0, 0};
+
+    static Vec<int> cell_for(const Vec<double>& position);
+};
+
+template <typename Visitor>
+void SpatialHashGrid::query_range(const AABB& range, Visitor&& visit) const {
+    Vec<double> min = range.center - range.half_dimension;
+    Vec<double> max = range.center + range.half_dimension;
+    Vec<int> first = cell_for(min - Vec<double>{double(max_size.x), double(max_size.y)});
+    Vec<int> last = cell_for(max);
+
+    auto visit_cell = [&](const std::vector<Element>& elements) {
+        for (const Element& element : elements) {
+            if (range.intersects(element.box)) {
+                visit(element.object);
+            }
+        }
+    };
+
+    // a range bigger than the occupied part of the grid walks the cells instead
+    std::size_t covered = std::size_t(last.x - first.x + 1) * std::size_t(last.y - first.y + 1);
+    if (covered > cells.size()) {
+        for (const auto& [cell, elements] : cells) {
+            visit_cell(elements);
+        }
+        return;
+    }
+
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            auto it = cells.find({x, y});
+            if (it != cells.end()) {
+                visit_cell(it->second);
+            }
+        }
+    }
+}
+
+template <typename Predicate>
+void SpatialHashGrid::query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const {
+    query_range(range, [&](Entity* object) {
+        if (predicate(object)) {
+            results.push_back(object);
+        }
+    });
+}
@@ -0,0 +1,69 @@
+#include "sweepandprune.h"
+#include <algorithm>
+
+void SweepAndPrune::clear() {
+    elements.clear();
+    max_width = 0;
+}
+
+void SweepAndPrune::insert(Entity* object) {
+    // kept at the end until the next update() sorts it into place
+    AABB box = bounding_box(*object);
+    elements.push_back(Element{object, box, box.center.x - box.half_dimension.x});
+    max_width = std::max(max_width, 2 * box.half_dimension.x);
+}
+
+bool SweepAndPrune::remove(Entity* object) {
+    auto element = std::find_if(elements.begin(), elements.end(), [&](const Element& e){return e.object == object;});
+    if (element == elements.end()) {
+        return false;
+    }
+    // erase rather than swap with the back, to keep the order
+    elements.erase(element);
+    return true;
+}
+
+void SweepAndPrune::update() {
+    for (Element& element : elements) {
+        element.box = bounding_box(*element.object);
+        element.min_x = element.box.center.x - element.box.half_dimension.x;
+        max_width = std::max(max_width, 2 * element.box.half_dimension.x);
+    }
+
+    // insertion sort: entities only move a little each tick, so few swaps
+    for (std::size_t i = 1; i < elements.size(); ++i) {
+        Element element = elements[i];
+        std::size_t j = i;
+        for (; j > 0 && elements[j - 1].min_x > element.min_x; --j) {
+            elements[j] = elements[j - 1];
+        }
+        elements[j] = element;
+    }
+}
+
+void SweepAndPrune::overlaps(const std::vector<AABB>& probes, std::vector<Overlap>& results) {
+    order.resize(probes.size());
+    for (std::size_t i = 0; i < probes.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return probes[a].center.x - probes[a].half_dimension.x < probes[b].center.x - probes[b].half_dimension.x;
+    });
+
+    // elements that start more than max_width left of a probe end before it,
+    // and since probes come in order they end before every later probe too
+    std::size_t first = 0;
+    for (std::size_t probe : order) {
+        const AABB& box = probes[probe];
+        double min_x = box.center.x - box.half_dimension.x;
+        double max_x = box.center.x + box.half_dimension.x;
+        while (first < elements.size() && elements[first].min_x + max_width <= min_x) {
+            ++first;
+        }
+        for (std::size_t i = first; i < elements.size() && elements[i].min_x < max_x; ++i) {
+            if (box.intersects(elements[i].box)) {
+                results.push_back(Overlap{probe, elements[i].object});
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "aabb.h"
+#include "entity.h"
+
+// All-pairs broadphase between a handful of probe boxes (projectiles) and the
+// entities stored here (enemies). Entities stay sorted by the left edge of
+// their bounding_box from one tick to the next, so update() re-sorts them in
+// close to linear time, and overlaps() finds every pair in one sweep along x.
+class SweepAndPrune {
+public:
+    void clear();
+    void insert(Entity* object);
+    bool remove(Entity* object);
+
+    // refresh the stored boxes from the entities and restore the order
+    void update();
+
+    struct Overlap {
+        std::size_t probe; // index into the probes passed to overlaps()
+        Entity* object;
+    };
+
+    // append a pair for every probe and entity whose boxes overlap, ordered
+    // by the probes' left edges (results is not cleared first)
+    void overlaps(const std::vector<AABB>& probes, std::vector<Overlap>& results);
+
+    struct Element {
+        Entity* object;
+        AABB box;
+        double min_x;
+    };
+    std::vector<Element> elements; // sorted by min_x after update()
+
+private:
+    double max_width{0}; // widest box stored, bounds how far back a sweep looks
+    std::vector<std::size_t> order; // probes sorted by left edge, reused
+};
@@ -1,32 +1,282 @@
 #include "tilemap.h"
 
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
 
-Tilemap::Tilemap(int width, int height)
-    : width{width}, height{height}, tiles(width * height) {
+// revisions come from one counter so no two tilemaps share one
+static std::uint64_t next_revision{0};
+
+Tilemap::Tilemap(int width, int height, const std::vector<Tile>& types, Source source)
+    : width{width}, height{height}, source{source}, row_words{(width + 2 + 63) / 64} {
     if (width < 1) {
         throw std::runtime_error("width must be positive");
     }
     if (height < 1) {
         throw std::runtime_error("height must be positive");
     }
+
+    // kept in the order given, even if two types look alike, so the source's
+    // indices stay valid
+    this->types.emplace_back();
+    for (const Tile& tile : types) {
+        this->types.push_back(tile);
+        add_animation(tile);
+    }
+    if (this->types.size() > std::size_t{std::numeric_limits<Type>::max()} + 1) {
+        throw std::runtime_error("too many tile types: " + std::to_string(this->types.size()));
+    }
+
+    blocking_bits.resize(static_cast<std::size_t>(height + 2) * row_words);
+    for (int x = -1; x <= width; ++x) {
+        set_blocking(x, -1, true);
+        set_blocking(x, height, true);
+    }
+    for (int y = 0; y < height; ++y) {
+        set_blocking(-1, y, true);
+        set_blocking(width, y, true);
+    }
+
+    chunks_wide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunks_high = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunks.resize(static_cast<std::size_t>(chunks_wide) * chunks_high);
+    std::uint64_t revision = ++next_revision;
+    for (Chunk& chunk : chunks) {
+        chunk.revision = revision;
+    }
+    if (!source) {
+        for (Chunk& chunk : chunks) {
+            chunk.empty = true;
+        }
+        return;
+    }
+
+    // one pass over the level for the bitmap, holding a single chunk at a
+    // time
+    for (int index = 0; index < static_cast<int>(chunks.size()); ++index) {
+        Chunk& chunk = load(index);
+        if (chunk.empty) {
+            continue;
+        }
+        int x0 = index % chunks_wide * CHUNK_SIZE;
+        int y0 = index / chunks_wide * CHUNK_SIZE;
+        for (int y = y0; y < std::min(y0 + CHUNK_SIZE, height); ++y) {
+            for (int x = x0; x < std::min(x0 + CHUNK_SIZE, width); ++x) {
+                Type type = chunk.cells[(x - x0) + (y - y0) * CHUNK_SIZE];
+                set_blocking(x, y, this->types[type].blocking);
+            }
+        }
+        std::vector<Type>().swap(chunk.cells);
+        resident.clear();
+    }
 }
 
-Tile& Tilemap::operator()(int x, int y) {
+const Tile& Tilemap::operator()(int x, int y) const {
     check_bounds(x, y);
-    return tiles.at(x + y * width);
+    const Chunk& chunk = load(x, y);
+    if (chunk.empty) {
+        return types.front();
+    }
+    return types[chunk.cells[x % CHUNK_SIZE + y % CHUNK_SIZE * CHUNK_SIZE]];
 }
 
-const Tile& Tilemap::operator()(int x, int y) const {
+void Tilemap::set(int x, int y, const Tile& tile) {
     check_bounds(x, y);
-    return tiles.at(x + y * width);
+    Type type = add_type(tile);
+    Chunk& chunk = load(x, y);
+    if (chunk.empty) {
+        if (type == 0) {
+            return;
+        }
+        chunk.cells.resize(CHUNK_SIZE * CHUNK_SIZE);
+        chunk.empty = false;
+        resident.push_back(x / CHUNK_SIZE + y / CHUNK_SIZE * chunks_wide);
+    }
+    chunk.cells[x % CHUNK_SIZE + y % CHUNK_SIZE * CHUNK_SIZE] = type;
+    chunk.edited = true;
+    chunk.revision = ++next_revision;
+    set_blocking(x, y, tile.blocking);
+}
+
+std::size_t Tilemap::type_count() const {
+    return types.size();
+}
+
+void Tilemap::evict_outside(int x0, int y0, int x1, int y1) {
+    auto outside = [&](int index) {
+        int x = index % chunks_wide * CHUNK_SIZE;
+        int y = index / chunks_wide * CHUNK_SIZE;
+        return x + CHUNK_SIZE <= x0 || x > x1 || y + CHUNK_SIZE <= y0 || y > y1;
+    };
+    for (std::size_t i = 0; i < resident.size();) {
+        Chunk& chunk = chunks[resident[i]];
+        if (!chunk.edited && outside(resident[i])) {
+            std::vector<Type>().swap(chunk.cells);
+            resident[i] = resident.back();
+            resident.pop_back();
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+std::size_t Tilemap::resident_chunks() const {
+    return resident.size();
+}
+
+std::uint64_t Tilemap::revision(int x, int y) const {
+    check_bounds(x, y);
+    return chunks[x / CHUNK_SIZE + y / CHUNK_SIZE * chunks_wide].revision;
+}
+
+Tilemap::Chunk& Tilemap::load(int x, int y) const {
+    return load(x / CHUNK_SIZE + y / CHUNK_SIZE * chunks_wide);
+}
+
+Tilemap::Chunk& Tilemap::load(int index) const {
+    Chunk& chunk = chunks[index];
+    if (chunk.empty || !chunk.cells.empty()) {
+        return chunk;
+    }
+
+    int x0 = index % chunks_wide * CHUNK_SIZE;
+    int y0 = index / chunks_wide * CHUNK_SIZE;
+    chunk.cells.resize(CHUNK_SIZE * CHUNK_SIZE);
+    bool air = true;
+    for (int y = y0; y < std::min(y0 + CHUNK_SIZE, height); ++y) {
+        for (int x = x0; x < std::min(x0 + CHUNK_SIZE, width); ++x) {
+            Type type = source(x, y);
+            chunk.cells[(x - x0) + (y - y0) * CHUNK_SIZE] = type;
+            air = air && type == 0;
+        }
+    }
+
+    if (air) {
+        std::vector<Type>().swap(chunk.cells);
+        chunk.empty = true;
+    }
+    else {
+        resident.push_back(index);
+    }
+    return chunk;
+}
+
+Tilemap::Type Tilemap::add_type(const Tile& tile) {
+    if (tile.air()) {
+        return 0;
+    }
+    auto same = [&](const Tile& type) {
+        return type.sprite == tile.sprite && type.blocking == tile.blocking && type.command == tile.command;
+    };
+    auto found = std::find_if(types.begin(), types.end(), same);
+    if (found != types.end()) {
+        return found - types.begin();
+    }
+
+    if (types.size() > std::numeric_limits<Type>::max()) {
+        throw std::runtime_error("too many tile types: " + std::to_string(types.size()));
+    }
+    types.push_back(tile);
+    add_animation(tile);
+    return types.size() - 1;
+}
+
+void Tilemap::add_animation(const Tile& tile) {
+    if (tile.sprite && std::find(animations.begin(), animations.end(), tile.sprite) == animations.end()) {
+        animations.push_back(tile.sprite);
+    }
+}
+
+bool Tilemap::any_blocking(int x0, int y0, int x1, int y1) const {
+    x0 = std::clamp(x0, -1, width) + 1;
+    x1 = std::clamp(x1, -1, width) + 1;
+    y0 = std::clamp(y0, -1, height) + 1;
+    y1 = std::clamp(y1, -1, height) + 1;
+    for (int y = y0; y <= y1; ++y) {
+        const std::uint64_t* row = &blocking_bits[static_cast<std::size_t>(y) * row_words];
+        // whole words at a time, masking off the ends of the span
+        for (int word = x0 / 64; word <= x1 / 64; ++word) {
+            std::uint64_t mask = ~std::uint64_t{0};
+            if (word == x0 / 64) {
+                mask &= ~std::uint64_t{0} << (x0 % 64);
+            }
+            if (word == x1 / 64) {
+                mask &= ~std::uint64_t{0} >> (63 - x1 % 64);
+            }
+            if (row[word] & mask) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Contact Tilemap::sweep_box(const Vec<double>& position, const Vec<int>& size, const Vec<double>& displacement) const {
+    // Amanatides-Woo with the box's leading edges: step to whichever tile
+    // boundary is reached next and test the strip of tiles entered there
+    constexpr double infinity = std::numeric_limits<double>::infinity();
+    Vec<double> min = position;
+    Vec<double> max{position.x + size.x, position.y + size.y};
+    int step_x = (displacement.x > 0) - (displacement.x < 0);
+    int step_y = (displacement.y > 0) - (displacement.y < 0);
+
+    // the next column and row entered and when they are reached
+    int column = step_x > 0 ? std::ceil(max.x) : std::floor(min.x) - 1;
+    int row = step_y > 0 ? std::ceil(max.y) : std::floor(min.y) - 1;
+    double t_x = step_x > 0 ? (column - max.x) / displacement.x
+               : step_x < 0 ? (column + 1 - min.x) / displacement.x : infinity;
+    double t_y = step_y > 0 ? (row - max.y) / displacement.y
+               : step_y < 0 ? (row + 1 - min.y) / displacement.y : infinity;
+    double delta_x = step_x != 0 ? 1 / std::abs(displacement.x) : infinity;
+    double delta_y = step_y != 0 ? 1 / std::abs(displacement.y) : infinity;
+
+    while (std::min(t_x, t_y) <= 1) {
+        double t = std::min(t_x, t_y);
+        // tiles covered at time t, not counting the ones being entered
+        int x0 = std::floor(min.x + displacement.x * t);
+        int x1 = std::ceil(max.x + displacement.x * t) - 1;
+        int y0 = std::floor(min.y + displacement.y * t);
+        int y1 = std::ceil(max.y + displacement.y * t) - 1;
+
+        bool hit_x = t_x == t && any_blocking(column, y0, column, y1);
+        bool hit_y = t_y == t && any_blocking(x0, row, x1, row);
+        if (hit_x || hit_y) {
+            return {t, {hit_x ? -step_x : 0, hit_y ? -step_y : 0}};
+        }
+        // passing exactly through a corner enters the diagonal tile as well
+        if (t_x == t && t_y == t && blocking(column, row)) {
+            return {t, {0, -step_y}};
+        }
+
+        if (t_x == t) {
+            column += step_x;
+            t_x += delta_x;
+        }
+        if (t_y == t) {
+            row += step_y;
+            t_y += delta_y;
+        }
+    }
+    return {1, {0, 0}};
 }
 
 void Tilemap::update(double dt) {
-    for (Tile& tile : tiles) {
-        tile.sprite.update(dt);
+    for (std::shared_ptr<AnimatedSprite>& animation : animations) {
+        animation->update(dt);
+    }
+}
+
+void Tilemap::set_blocking(int x, int y, bool blocking) {
+    std::uint64_t& word = blocking_bits[static_cast<std::size_t>(y + 1) * row_words + (x + 1) / 64];
+    std::uint64_t bit = std::uint64_t{1} << ((x + 1) % 64);
+    if (blocking) {
+        word |= bit;
+    }
+    else {
+        word &= ~bit;
     }
 }
 
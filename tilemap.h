@@ -1,27 +1,110 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <vector>
-#include "sprite.h"
+#include "animatedsprite.h"
 #include "command.h"
+#include "vec.h"
 
 class Tile {
 public:
-    AnimatedSprite sprite;
+    // shared by every tile of a type so they animate in lockstep, empty for air
+    std::shared_ptr<AnimatedSprite> sprite{nullptr};
     bool blocking{false};
     std::shared_ptr<Command> command{nullptr};
+    bool air() const {
+        return !sprite && !blocking && !command;
+    }
 };
 
+// first contact of a box moving through the tilemap: time is the fraction
+// of the motion made before touching, normal points out of the tile hit
+struct Contact {
+    double time{1};
+    Vec<int> normal; // {0, 0} when nothing was hit
+    bool hit() const {
+        return normal.x != 0 || normal.y != 0;
+    }
+};
+
+// Each cell holds an index into a table of tile types, type 0 being air.
+// Cells are stored in CHUNK_SIZE square chunks. All-air chunks hold
+// nothing, and the rest are loaded from the level's source when first read
+// and can be evicted again once they are out of view. Only the blocking
+// bitmap below covers the whole map, since enemies collide everywhere.
 class Tilemap {
 public:
-    Tilemap(int width, int height);
-    Tile& operator()(int x, int y);
+    using Type = std::uint16_t;
+
+    // rebuilds the cells of a chunk that becomes resident: the type of the
+    // level's tile at (x, y)
+    using Source = std::function<Type(int x, int y)>;
+
+    // types are the tiles the source refers to, after the implicit air
+    Tilemap(int width, int height, const std::vector<Tile>& types = {}, Source source = nullptr);
     const Tile& operator()(int x, int y) const;
     void update(double dt);
-   
 
+    // replaces a tile, adding a type for it if no existing one matches.
+    // Edited chunks stay resident, as the source can't rebuild them
+    void set(int x, int y, const Tile& tile);
+    std::size_t type_count() const;
+
+    // frees every unedited chunk that doesn't overlap the given tiles
+    void evict_outside(int x0, int y0, int x1, int y1);
+    std::size_t resident_chunks() const;
+
+    // changes whenever a tile in the chunk holding (x, y) is set, and is
+    // never shared between tilemaps, so it can key caches of the tiles
+    std::uint64_t revision(int x, int y) const;
+
+    // collision reads go through a packed bitmap instead of the tiles, with
+    // no bounds check: everything outside the map is solid
+    bool blocking(int x, int y) const;
+    bool any_blocking(int x0, int y0, int x1, int y1) const; // inclusive
+
+    // walks the tiles a box of whole tiles enters while moving by
+    // displacement, so nothing is tunnelled through however far it goes.
+    // Tiles the box already overlaps are ignored
+    Contact sweep_box(const Vec<double>& position, const Vec<int>& size, const Vec<double>& displacement) const;
 
     const int width;
     const int height;
+    static constexpr int CHUNK_SIZE = 32;
+
 private:
-    std::vector<Tile> tiles;
+    struct Chunk {
+        std::vector<Type> cells; // none when all air or not resident
+        bool empty{false};       // known to be all air
+        bool edited{false};
+        std::uint64_t revision{0};
+    };
+    Source source;
+    int chunks_wide, chunks_high;
+    mutable std::vector<Chunk> chunks;
+    mutable std::vector<int> resident; // chunks holding cells
+    Chunk& load(int x, int y) const;   // chunk containing tile (x, y)
+    Chunk& load(int index) const;
+
+    // a deque, so references to types stay valid as types are added
+    std::deque<Tile> types;
+    std::vector<std::shared_ptr<AnimatedSprite>> animations; // one per animated type
+    Type add_type(const Tile& tile);
+    void add_animation(const Tile& tile);
     void check_bounds(int x, int y) const; // error handling
-};
\ No newline at end of file
+
+    // one bit per tile, one tile of solid border on every side, rows padded
+    // to whole words
+    int row_words;
+    std::vector<std::uint64_t> blocking_bits;
+    void set_blocking(int x, int y, bool blocking);
+};
+
+inline bool Tilemap::blocking(int x, int y) const {
+    x = std::clamp(x, -1, width) + 1;
+    y = std::clamp(y, -1, height) + 1;
+    return blocking_bits[static_cast<std::size_t>(y) * row_words + x / 64] >> (x % 64) & 1;
+}
\ No newline at end of file
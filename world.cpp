@@ -1,124 +1,143 @@
 #include "world.h"
-#include "player.h"
 #include <cmath>
+#include <stdexcept>
 
-World::World(const Level& level)
-    :tilemap{level.width, level.height}, backgrounds{level.backgrounds}, quadtree{AABB{{level.width / 2.0, level.height / 2.0}, {level.width / 2.0, level.height / 2.0}}} {
-    
-    for (auto [position, tile] : level.tiles) {
-        tilemap(position.x, position.y) = tile;
+World::World(const Level& level, const std::string& broadphase)
+    :tilemap{level.width, level.height, level.tile_table(), level.tile_source()}, backgrounds{level.backgrounds}, quadtree{AABB{{level.width / 2.0, level.height / 2.0}, {level.width / 2.0, level.height / 2.0}}, true},
+     use_grid{broadphase == "grid"} {
+    if (broadphase != "grid" && broadphase != "quadtree") {
+        throw std::runtime_error("Unknown broadphase '" + broadphase + "', expected quadtree or grid");
+    }
+
+    for (int y = 0; y < level.height; ++y) {
+        const std::string& row = (*level.layout)[level.height - 1 - y];
+        for (int x = 0; x < level.width; ++x) {
+            auto it = level.tile_types.find(row[x]);
+            if (it != level.tile_types.end() && it->second.command) {
+                triggers[{x, y}] = it->second.command;
+            }
+        }
     }
     for (auto [position, type] : level.enemies) {
         enemies.push_back(std::make_shared<Enemy>(position, Vec<int>{1,1}, type));
     }
+    build_spatial_index();
 }
 
-void World::move_to(Vec<double>& position, const Vec<int>& size, Vec<double>& velocity) {
-    // test sides first, if both collide then move backwards
-    // bottom side
-    if (collides(position) && collides({position.x + size.x, position.y})) {
-        position.y = std::ceil(position.y);
-        velocity.y = 0;
-    }
-    // top side
-    else if (collides({position.x, position.y + size.y}) && collides({position.x + size.x, position.y + size.y})) {
-        position.y = std::floor(position.y);
-        velocity.y = 0;
-    }
-    // left side
-    else if (collides(position) && collides({position.x, position.y + size.y})) {
-        position.x = std::ceil(position.x);
-        velocity.x = 0;
-    }
-    // right side
-    else if (collides({position.x + size.x, position.y}) && collides({position.x + size.x, position.y + size.y})) {
-        position.x = std::floor(position.x);
-        velocity.x = 0;
-    }
-    
-    // test corners next, move back in smaller axis
-    else if (collides(position)) {
-        double dx = std::ceil(position.x) - position.x;
-        double dy = std::ceil(position.y) - position.y;
-        if (dx > dy) {
-            position.y = std::ceil(position.y);
-            velocity.y = 0;
-        }
-        else {
-            position.x = std::ceil(position.x);
-            velocity.x = 0;
+void World::move_by(Vec<double>& position, const Vec<int>& size, Vec<double>& velocity, Vec<double> displacement) const {
+    // every contact stops the motion along at least one axis, so this
+    // sweeps at most twice
+    while (displacement.x != 0 || displacement.y != 0) {
+        Contact contact = tilemap.sweep_box(position, size, displacement);
+        position += displacement * contact.time;
+        if (!contact.hit()) {
+            return;
         }
-    }
-    else if (collides({position.x, position.y + size.y})) {
-        double dx = std::ceil(position.x) - position.x;
-        double dy = position.y - std::floor(position.y);
-        if (dx > dy) {
-            position.y = std::floor(position.y);
-            velocity.y = 0;
-        }
-        else {
-            position.x = std::ceil(position.x);
+
+        // sizes are whole tiles, so a box touching a tile sits on a tile
+        // boundary: snap to it so rounding can't carry it into the tile
+        displacement = displacement * (1 - contact.time);
+        if (contact.normal.x != 0) {
+            position.x = std::round(position.x);
+            displacement.x = 0;
             velocity.x = 0;
         }
-    }
-    else if (collides({position.x + size.x, position.y})) {
-        double dx = position.x - std::floor(position.x);
-        double dy = std::ceil(position.y) - position.y;
-        if (dx > dy) {
-            position.y = std::ceil(position.y);
+        if (contact.normal.y != 0) {
+            position.y = std::round(position.y);
+            displacement.y = 0;
             velocity.y = 0;
         }
-        else {
-            position.x = std::floor(position.x);
-            velocity.x = 0;
-        }
-    }
-    else if (collides({position.x + size.x, position.y + size.y})) {
-        double dx = position.x - std::floor(position.x);
-        double dy = position.y - std::floor(position.y);
-        if (dx > dy) {
-            position.y = std::floor(position.y);
-            velocity.y = 0;
-        }
-        else {
-            position.x = std::floor(position.x);
-            velocity.x = 0;
-        }
     }
 }
 
 bool World::collides(const Vec<double>& position) const {
     int x = std::floor(position.x);
     int y = std::floor(position.y);
-    return tilemap(x, y).blocking;
+    return tilemap.blocking(x, y);
 }
 
-std::shared_ptr<Command> World::touch_tiles(const Player& player) {
-    int x = std::floor(player.physics.position.x);
-    int y = std::floor(player.physics.position.y);
-    const Vec<int>& size = player.size;
-    const std::vector<Vec<int>> displacements{{0,0}, {size.x,0}, {0,size.y}, {size.x,size.y}};
-    for (const Vec<int>& displacement : displacements) {
-        Tile& tile = tilemap(x + displacement.x, y + displacement.y);
-        if (tile.command) {
-            auto command = tile.command;
-            tile.command = nullptr;
-            return command;
+std::shared_ptr<Command> World::touch_triggers(const Entity& entity) {
+    if (triggers.empty()) {
+        return nullptr;
+    }
+
+    // every tile the entity's box touches, edges included
+    int x0 = std::floor(entity.physics.position.x);
+    int y0 = std::floor(entity.physics.position.y);
+    int x1 = x0 + entity.size.x;
+    int y1 = y0 + entity.size.y;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            auto it = triggers.find({x, y});
+            if (it != triggers.end()) {
+                auto command = it->second;
+                triggers.erase(it);
+                return command;
+            }
         }
     }
     return nullptr;
 }
 
 void World::remove_inactive() {
+    for (std::shared_ptr<Enemy> enemy : enemies) {
+        if (!enemy->combat.render) {
+            if (use_grid) {
+                grid.remove(enemy.get(), enemy->indexed_position);
+            }
+            else {
+                quadtree.remove(enemy.get(), enemy->indexed_position);
+            }
+            sweep.remove(enemy.get());
+        }
+    }
     enemies.erase(std::remove_if(enemies.begin(), enemies.end(), [](std::shared_ptr<Enemy>enemy){return !enemy->combat.render;}), enemies.end());
     projectiles.erase(std::remove_if(std::begin(projectiles), std::end(projectiles), [](const Projectile& projectile){return !projectile.combat.is_alive;}), std::end(projectiles));
 
 }
 
-void World::build_quadtree() {
+void World::build_spatial_index() {
+    grid.clear();
+    sweep.clear();
+
+    std::vector<Entity*> indexed;
+    indexed.reserve(enemies.size());
+    for (std::shared_ptr<Enemy> enemy : enemies) {
+        if (use_grid) {
+            grid.insert(enemy.get());
+        }
+        indexed.push_back(enemy.get());
+        sweep.insert(enemy.get());
+        enemy->indexed_position = enemy->physics.position;
+    }
+    sweep.update();
+
+    // crowded levels build the tree's quadrants in parallel
     quadtree.clear();
+    if (!use_grid) {
+        quadtree.build(indexed);
+    }
+}
 
+void World::update_spatial_index() {
+    // only enemies that left their leaf or cell are relinked
     for (std::shared_ptr<Enemy> enemy : enemies) {
-        quadtree.insert(enemy.get());
+        if (use_grid) {
+            grid.update(enemy.get(), enemy->indexed_position);
+        }
+        else {
+            quadtree.update(enemy.get(), enemy->indexed_position);
+        }
+        enemy->indexed_position = enemy->physics.position;
+    }
+    sweep.update();
+}
+
+void World::query_range(const AABB& range, std::vector<Entity*>& results) const {
+    if (use_grid) {
+        grid.query_range(range, results);
+    }
+    else {
+        quadtree.query_range(range, results);
     }
 }
\ No newline at end of file
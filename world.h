@@ -6,22 +6,50 @@
 #include "command.h"
 #include "enemy.h"
 #include "quadtree.h"
-
-class Player;
+#include "spatialhashgrid.h"
+#include "sweepandprune.h"
+#include <unordered_map>
 
 class World {
 public:
-    World(const Level& level);
-    void move_to(Vec<double>& position, const Vec<int>& size, Vec<double>& velocity);
+    World(const Level& level, const std::string& broadphase);
+    // moves a box by displacement, sliding along any tiles it runs into and
+    // zeroing velocity into them
+    void move_by(Vec<double>& position, const Vec<int>& size, Vec<double>& velocity, Vec<double> displacement) const;
     bool collides(const Vec<double>& position) const;
 
-    std::shared_ptr<Command> touch_tiles(const Player& player);
+    // command tiles by position, each fired once by the first entity that
+    // touches it
+    std::unordered_map<Vec<int>, std::shared_ptr<Command>> triggers;
+    std::shared_ptr<Command> touch_triggers(const Entity& entity);
     std::vector<std::shared_ptr<Enemy>> enemies;
     std::vector<Projectile> projectiles;
 
     Tilemap tilemap;
     std::vector<std::pair<Sprite, int>> backgrounds;
-    QuadTree quadtree;
     void remove_inactive();
-    void build_quadtree();
+
+    // enemies are indexed by whichever broadphase the settings picked:
+    // "quadtree" for big or crowded levels, "grid" for sparse tile sized ones
+    QuadTree quadtree;
+    SpatialHashGrid grid;
+    bool use_grid;
+    void build_spatial_index();
+    void update_spatial_index();
+    void query_range(const AABB& range, std::vector<Entity*>& results) const;
+    template <typename Predicate>
+    void query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const;
+
+    // enemies again, for resolving every projectile in one pass
+    SweepAndPrune sweep;
 };
+
+template <typename Predicate>
+void World::query_range(const AABB& range, std::vector<Entity*>& results, Predicate predicate) const {
+    if (use_grid) {
+        grid.query_range(range, results, predicate);
+    }
+    else {
+        quadtree.query_range(range, results, predicate);
+    }
+}